@@ -0,0 +1,83 @@
+#ifndef RAYCAST_BUFFERMANAGER_HPP
+#define RAYCAST_BUFFERMANAGER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+/**
+ * Streams vertex data of recalculated models into a single vertex buffer.
+ *
+ * The buffer is split into three regions used in turn, every upload fills
+ * the next region with all point sets of a model. The gpu may still read the
+ * two older regions, a fence per region guards against overwriting them too
+ * early. With immutable storage the buffer stays mapped persistently and an
+ * upload is a plain memcpy, otherwise it falls back to glBufferSubData.
+ */
+class BufferManager {
+
+public:
+
+    BufferManager();
+
+    /**
+     * Creates the buffer
+     * @param region_size bytes available to a single upload, grows on demand
+     * @return false if the buffer could not be created
+     */
+    bool initialize(size_t region_size);
+
+    /**
+     * Switches to the next region, waiting until the gpu is done reading from it.
+     * Everything drawn from earlier regions has to be submitted already.
+     * @param num_bytes total size of all following writes, the buffer gets reallocated if they do not fit
+     */
+    void beginUpload(size_t num_bytes);
+
+    /**
+     * Copies data into the current region
+     * @param data
+     * @param num_bytes
+     * @return offset of the data within the buffer
+     */
+    GLintptr write(void const *data, size_t num_bytes);
+
+    /**
+     * Size a write of the given number of bytes takes up in a region
+     * @param num_bytes
+     * @return
+     */
+    static size_t alignedSize(size_t num_bytes);
+
+    GLuint get_buffer_id() const;
+    bool is_persistent() const;
+
+    /**
+     * Deletes the buffer and its fences, has to be called while the context is still alive
+     */
+    void release();
+
+private:
+
+    /**
+     * (Re)creates the buffer with room for three regions of the given size
+     * @param region_size
+     * @return
+     */
+    bool allocate(size_t region_size);
+
+    GLuint _buffer_id;
+    char *_mapped;
+    bool _persistent;
+
+    size_t _region_size;
+    int _region_idx;
+    size_t _region_offset;
+
+    // signaled once the gpu stopped reading from a region
+    std::vector<GLsync> _fences;
+};
+
+
+#endif //RAYCAST_BUFFERMANAGER_HPP
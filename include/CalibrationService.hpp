@@ -0,0 +1,127 @@
+#ifndef RAYCAST_CALIBRATIONSERVICE_HPP
+#define RAYCAST_CALIBRATIONSERVICE_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <lib/json11.hpp>
+
+#include "DomeProjector.hpp"
+#include "SharedMesh.hpp"
+#include "Sphere.hpp"
+
+/**
+ * Recomputes the warp mesh for parameter changes sent over a unix domain socket.
+ *
+ * Every request is a single line of json, e.g.
+ *   {"id": 1, "mirror": {"position": [0, 0.8, -1.7], "radius": 0.4},
+ *    "dome": {"radius": 1.6}, "projector": {"fov": 70}, "reply": "mesh"}
+ * All fields are optional. The answer is a single line of json holding the
+ * request id, the mapping metrics and, on request, the mesh itself.
+ *
+ * The projector and its sample grid stay alive between requests. Requests that
+ * arrive while a mesh is computed are merged in arrival order and computed
+ * once, so a request waits for at most the running and its own computation.
+ * {"command": "shutdown"} stops the service.
+ */
+class CalibrationService {
+
+public:
+
+    /**
+     * Creates a service working on the given model, which stays owned by the caller
+     * @param projector
+     * @param mirror
+     * @param dome
+     * @param publisher optional, every computed mesh gets published through it when open
+     */
+    CalibrationService(DomeProjector *projector, Sphere *mirror, Sphere *dome, SharedMeshPublisher *publisher);
+
+    ~CalibrationService();
+
+    /**
+     * Starts listening on the given socket path, replacing a stale socket file
+     * @param socket_path
+     * @return false if the socket could not be created
+     */
+    bool open(std::string const &socket_path);
+
+    /**
+     * Serves requests until stop() gets called or a shutdown request arrives
+     */
+    void run();
+
+    /**
+     * Makes run() return, safe to call from a signal handler
+     */
+    void stop();
+
+private:
+
+    struct Client {
+        int fd;
+        std::string input;
+        std::string output;
+
+        // the client shut down its sending side and waits for its answers
+        bool eof;
+    };
+
+    struct Request {
+        int fd;
+        json11::Json message;
+    };
+
+    void acceptClients();
+
+    /**
+     * Reads everything available and queues all complete lines as requests
+     * @param client
+     * @return false if the client disconnected or misbehaved
+     */
+    bool readClient(Client *client);
+
+    /**
+     * Writes as much of the pending output as the socket accepts
+     * @param client
+     * @return false if the client disconnected
+     */
+    bool writeClient(Client *client);
+
+    /**
+     * Applies all queued requests, computes the mesh once and answers every request
+     */
+    void processRequests();
+
+    /**
+     * Applies the parameters of a single request to the model
+     * @param message
+     * @param error set if a parameter is invalid
+     * @return false if the request got rejected
+     */
+    bool applyRequest(json11::Json const &message, std::string *error);
+
+    void reply(int fd, json11::Json const &message);
+
+    void closeClient(unsigned long client_idx);
+
+    json11::Json metricsToJson() const;
+
+    json11::Json meshToJson() const;
+
+    DomeProjector *_projector;
+    Sphere *_mirror;
+    Sphere *_dome;
+    SharedMeshPublisher *_publisher;
+
+    std::string _socket_path;
+    int _listen_fd;
+    std::atomic<bool> _running;
+
+    std::vector<Client> _clients;
+    std::vector<Request> _requests;
+};
+
+
+#endif //RAYCAST_CALIBRATIONSERVICE_HPP
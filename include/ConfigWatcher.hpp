@@ -0,0 +1,81 @@
+#ifndef RAYCAST_CONFIGWATCHER_HPP
+#define RAYCAST_CONFIGWATCHER_HPP
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Watches a set of files and reports changes once the edits settled down.
+ *
+ * Editors often save by writing a temporary file and renaming it, so the
+ * directories of the files are watched rather than the files themselves.
+ * Uses inotify on linux and compares modification times elsewhere.
+ */
+class ConfigWatcher {
+
+public:
+
+    /**
+     * Called on the watcher thread with all files changed since the last call
+     */
+    typedef std::function<void(std::vector<std::string> const &)> Callback;
+
+    /**
+     * @param paths files to watch
+     * @param debounce_ms quiet time after the last change before the callback fires
+     * @param callback
+     */
+    ConfigWatcher(std::vector<std::string> const &paths, int debounce_ms, Callback const &callback);
+
+    ~ConfigWatcher();
+
+    /**
+     * Starts the watcher thread
+     * @return false if the files could not be watched
+     */
+    bool start();
+
+    /**
+     * Stops and joins the watcher thread
+     */
+    void stop();
+
+private:
+
+    void watch();
+
+    /**
+     * Blocks until at least one watched file changed or the watcher got stopped
+     * @param timeout_ms negative to wait forever
+     * @param changed receives the changed files
+     */
+    void waitForChanges(int timeout_ms, std::vector<std::string> *changed);
+
+    /**
+     * Drains pending inotify events and collects the watched files among them
+     * @param changed
+     */
+    void readEvents(std::vector<std::string> *changed);
+
+    std::vector<std::string> _paths;
+    int _debounce_ms;
+    Callback _callback;
+
+    std::thread _thread;
+    std::atomic<bool> _running;
+
+    // inotify descriptor and the pipe used to interrupt its poll
+    int _notify_fd;
+    int _wake_fds[2];
+    std::vector<int> _watch_descriptors;
+    std::vector<std::string> _directories;
+
+    // last seen modification times where inotify is not available
+    std::vector<long> _modification_times;
+};
+
+
+#endif //RAYCAST_CONFIGWATCHER_HPP
@@ -0,0 +1,59 @@
+#ifndef RAYCAST_DOMEMESH_HPP
+#define RAYCAST_DOMEMESH_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Indexed triangle mesh of the warp, ready to be uploaded as vertex and index buffer.
+ *
+ * Every vertex holds its screen position followed by its texture coordinate
+ * (x, y, u, v). Indices are stored with 16 bit whenever the vertex count allows it.
+ */
+struct DomeMesh {
+
+    DomeMesh();
+
+    /**
+     * Sets the triangle list and picks the smallest fitting index type
+     * @param indices three indices per triangle
+     * @param num_vertices
+     */
+    void setTriangles(std::vector<unsigned int> const &indices, unsigned long num_vertices);
+
+    /**
+     * Interleaves screen points and texture coordinates into the vertex buffer
+     * @param screen_points
+     * @param texture_coords
+     */
+    void setVertices(std::vector<glm::vec3> const &screen_points, std::vector<glm::vec3> const &texture_coords);
+
+    bool is16Bit() const;
+
+    unsigned long numVertices() const;
+    unsigned long numIndices() const;
+
+    /**
+     * Raw index buffer and its size in bytes, as expected by glBufferData
+     * @return
+     */
+    void const *indexData() const;
+    unsigned long indexBytes() const;
+
+    /**
+     * Returns the i-th index regardless of the index type
+     * @param i
+     * @return
+     */
+    unsigned int index(unsigned long i) const;
+
+    static const int FLOATS_PER_VERTEX = 4;
+
+    std::vector<float> vertices;
+    std::vector<unsigned short> indices16;
+    std::vector<unsigned int> indices32;
+};
+
+
+#endif //RAYCAST_DOMEMESH_HPP
@@ -10,11 +10,17 @@
 #include <map>
 #include <ostream>
 #include <limits>
+#include <string>
 
 #include <glm/glm.hpp>
 
 #include "Frustum.hpp"
 #include "Sphere.hpp"
+#include "MappingMetrics.hpp"
+#include "SpatialGrid.hpp"
+#include "GridGenerator.hpp"
+#include "DomeMesh.hpp"
+#include "ResultView.hpp"
 
 
 struct Screen {
@@ -32,14 +38,55 @@ class DomeProjector {
 
 public:
 
+    /**
+     * NEAREST snaps each dome vertex to the closest second hit.
+     * BARYCENTRIC interpolates within the triangle of neighbouring grid samples
+     * whose second hits surround the dome vertex.
+     * WALK snaps like NEAREST but searches downhill through the grid starting at the
+     * previous dome vertex's hit.
+     */
+    enum MappingMode {
+        NEAREST, BARYCENTRIC, WALK
+    };
+
+    /**
+     * LAT_LONG places the dome vertices on rings around the zenith.
+     * GEODESIC subdivides an icosahedron and keeps its upper half, spacing the
+     * vertices almost uniformly.
+     */
+    enum DomeTessellation {
+        LAT_LONG, GEODESIC
+    };
+
+    /**
+     * Local geometry of a single sample's path from the projector into the dome.
+     * The footprint is the dome area covered per unit of sample grid area, so it
+     * already carries the spread caused by the incidence angle and the path length.
+     * The gain scales the sample so all of the dome matches its dimmer regions.
+     */
+    struct BrightnessSample {
+        float footprint;
+        float cos_incidence;
+        float path_length;
+        float gain;
+    };
+
+    /**
+     * Area of the dome lit by a single projector pixel, spanned by two
+     * orthogonal semi axes. Both axes are 0 for lost rays.
+     */
+    struct FootprintEllipse {
+        glm::vec3 major_axis;
+        glm::vec3 minor_axis;
+    };
+
     /**
      * Creates a dome projector object alongside the specified sample grid
      * @param _frustum
      * @param _screen
-     * @param _grid_rings
-     * @param _grid_ring_elements
+     * @param grid_generator
      */
-    DomeProjector(Frustum *_frustum, Screen *_screen, int _grid_rings, int _grid_ring_elements,
+    DomeProjector(Frustum *_frustum, Screen *_screen, GridGenerator const &grid_generator,
                   glm::vec3 const &position, int dome_rings, int dome_ring_elements);
 
     /**
@@ -53,6 +100,14 @@ public:
      */
     std::vector<glm::vec3> calculateTransformationMesh();
 
+    /**
+     * Seeds the nearest hit searches of the next mapping with the results of a coarser
+     * level of the same setup. Every dome vertex starts its search at the sample the
+     * closest coarse dome vertex got mapped to. The seeds get used up by the mapping.
+     * @param coarse
+     */
+    void seedMapping(DomeProjector const &coarse);
+
     /**
      * calculates hitpoints in the dome
      * @param mirror
@@ -60,18 +115,56 @@ public:
      */
     void calculateDomeHitpoints(Sphere *mirror, Sphere *dome);
 
+    /**
+     * Estimates the brightness of every sample from the local jacobian of the
+     * sample grid to dome mapping. Lost rays and samples without enough neighbours keep a gain of 1.
+     */
+    void calculateBrightness();
+
     /**
      * saves transformations to text file with maybe some time the current timestamp
      */
     void saveTransformations() const;
 
-    // getter
-    std::vector<glm::vec3> const &get_sample_grid() const;
-    std::vector<glm::vec3> const &get_first_hits() const;
-    std::vector<glm::vec3> const &get_second_hits() const;
-    std::vector<glm::vec3> const &get_dome_vertices() const;
-    std::vector<glm::vec3> const &get_screen_points() const;
-    std::vector<glm::vec3> const &get_texture_coords() const;
+    /**
+     * Exports the warp mesh and the sample, hit and dome vertex sets as binary ply files
+     * and as a single glb scene
+     * @param directory prefix of all written files
+     */
+    void exportGeometry(std::string const &directory) const;
+
+    // getter, the views stay valid until the generation changes
+    Screen const &get_screen() const;
+    glm::vec3 get_position() const;
+    unsigned long get_generation() const;
+    ResultView<glm::vec3> get_sample_grid() const;
+    ResultView<glm::vec3> get_first_hits() const;
+    ResultView<glm::vec3> get_second_hits() const;
+    ResultView<glm::vec3> get_dome_vertices() const;
+    std::vector<unsigned int> const &get_dome_indices() const;
+    ResultView<glm::vec3> get_screen_points() const;
+    ResultView<glm::vec3> get_texture_coords() const;
+    std::vector<glm::vec2> const &get_pixel_lut() const;
+    std::vector<BrightnessSample> const &get_brightness() const;
+    std::vector<float> const &get_vertex_gains() const;
+    std::vector<int> const &get_vertex_samples() const;
+    std::vector<FootprintEllipse> const &get_footprint_ellipses() const;
+    DomeMesh const &get_mesh() const;
+    MappingMetrics const &get_metrics() const;
+
+    // setter
+    void set_snap_tolerance(float tolerance);
+    void set_mapping_mode(MappingMode mode);
+    void set_dome_tessellation(DomeTessellation tessellation, int subdivisions);
+    void set_frustum(Frustum *frustum);
+    void set_ray_differentials(bool enabled);
+
+    /**
+     * Checks whether a hit is the marker of a lost ray
+     * @param hit
+     * @return
+     */
+    static bool isMiss(glm::vec3 const &hit);
 
     // ostream
     friend std::ostream &operator<<(std::ostream &os, const DomeProjector &projector);
@@ -80,36 +173,180 @@ public:
 private:
 
     /**
-     * generates a radial grid
-     * @return
+     * Outcome of a single ray
+     */
+    enum RayStatus {
+        DOME_HIT, MIRROR_MISS, DOME_MISS, BELOW_EQUATOR
+    };
+
+    /**
+     * Traces the ray of a single sample via the mirror into the dome
+     * @param sample_idx
+     * @param mirror
+     * @param dome
+     */
+    void castRay(unsigned long sample_idx, Sphere *mirror, Sphere *dome);
+
+    /**
+     * Builds screen points, texture coordinates and the pixel lut of a pixel aligned grid
+     */
+    void calculatePixelMapping();
+
+    /**
+     * generates the sample grid on the near clipping plane
      */
-    void generateRadialGrid();
+    void generateSampleGrid();
 
     /**
      * Generates the vertices of a half sphere by using the grid specified settings
+     * alongside the triangles connecting them
      */
     void generateDomeVertices();
 
+    /**
+     * Generates the pole cap and rings of equally spaced latitudes and longitudes
+     */
+    void generateLatLongVertices();
+
+    /**
+     * Generates the upper half of a subdivided icosahedron
+     */
+    void generateGeodesicVertices();
+
+    /**
+     * Finds the second hit closest to the given point
+     * @param point
+     * @param distance set to the distance of the found hit
+     * @return index of the hit or -1 if all rays got lost
+     */
+    int findNearestHit(glm::vec3 const &point, float *distance);
+
+    /**
+     * Walks from the seed sample along the grid towards the given point and confirms
+     * the closest hit with a search of the hit grid within the walks distance.
+     * @param point
+     * @param seed_idx sample to start at, a negative index searches all hits
+     * @param distance set to the distance of the found hit
+     * @return index of the hit or -1 if all rays got lost
+     */
+    int walkToNearestHit(glm::vec3 const &point, int seed_idx, float *distance);
+
+    /**
+     * Scans a sparse subset of the grid for the hit closest to the given point
+     * @param point
+     * @return index of the hit or -1 if all rays got lost
+     */
+    int findCoarseSeed(glm::vec3 const &point);
+
+    /**
+     * Puts all valid second hits into a uniform grid for the search confirming the walks
+     */
+    void buildHitGrid();
+
+    /**
+     * Steps from the seed sample to its closest neighbour until none of them gets closer
+     * @param point
+     * @param seed_idx
+     * @param distance set to the distance of the last hit
+     * @param settled set to false if the point lies further away than the surrounding samples
+     * @return index of the last hit
+     */
+    int descend(glm::vec3 const &point, int seed_idx, float *distance, bool *settled);
+
+    /**
+     * Collects the samples surrounding the given sample on the grid
+     * @param sample_idx
+     * @param neighbours
+     */
+    void sampleNeighbours(int sample_idx, std::vector<int> *neighbours) const;
+
+    /**
+     * Triangulates the second hits along the rows of the sample grid
+     */
+    void buildSampleTriangles();
+
+    /**
+     * Finds the hit triangle surrounding the given point
+     * @param point
+     * @param corners set to the samples of the triangle
+     * @param weights set to the barycentric weights of the corners
+     * @param distance set to the distance of the point to the triangle
+     * @return false if no triangle surrounds the point
+     */
+    bool findSampleTriangle(glm::vec3 const &point, unsigned int const **corners, glm::vec3 *weights,
+                            float *distance) const;
+
+    /**
+     * Fits the jacobian of the sample grid to dome mapping around a sample to its grid neighbours
+     * @param sample_idx
+     * @param neighbours scratch list
+     * @return dome area per unit of grid area, 0 if the neighbours do not span an area
+     */
+    float sampleFootprint(int sample_idx, std::vector<int> *neighbours) const;
+
+    /**
+     * Adds a valid dome hit to the hit count of its ring band
+     * @param hit
+     * @param dome
+     */
+    void countRingHit(glm::vec3 const &hit, Sphere *dome);
+
     // members
     Frustum *_frustum;
     Screen *_screen;
 
     glm::vec3 _position;
 
-    int _grid_rings;
-    int _grid_ring_elements;
+    GridGenerator _grid_generator;
+    SampleGrid _grid;
+
+    // bumped whenever the result buffers get rewritten
+    unsigned long _generation;
 
     int _dome_rings;
     int _dome_ring_elements;
+    DomeTessellation _dome_tessellation;
+    int _dome_subdivisions;
 
     std::vector<glm::vec3> _sample_grid;
     std::vector<glm::vec3> _first_hits;
     std::vector<glm::vec3> _second_hits;
+    std::vector<RayStatus> _ray_status;
+
+    bool _ray_differentials;
+    glm::vec3 _pixel_step_x;
+    glm::vec3 _pixel_step_y;
+    std::vector<FootprintEllipse> _footprint_ellipses;
+
+    glm::vec3 _dome_center;
+    float _dome_radius;
 
+    std::vector<glm::vec3> _dome_unit_vertices;
     std::vector<glm::vec3> _dome_vertices;
+    std::vector<unsigned int> _dome_indices;
 
     std::vector<glm::vec3> _screen_points;
     std::vector<glm::vec3> _texture_coords;
+    std::vector<glm::vec2> _pixel_lut;
+    DomeMesh _mesh;
+
+    std::vector<BrightnessSample> _brightness;
+    std::vector<float> _vertex_gains;
+
+    float _snap_tolerance;
+    MappingMetrics _metrics;
+
+    MappingMode _mapping_mode;
+
+    // sample each dome vertex got mapped to, -1 if unmapped
+    std::vector<int> _vertex_samples;
+    std::vector<int> _mapping_seeds;
+
+    std::vector<unsigned int> _sample_triangles;
+    SpatialGrid _triangle_grid;
+    SpatialGrid _hit_grid;
+    std::vector<int> _hit_grid_indices;
+    std::vector<int> _neighbour_scratch;
 };
 
 
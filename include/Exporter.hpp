@@ -0,0 +1,62 @@
+#ifndef RAYCAST_EXPORTER_HPP
+#define RAYCAST_EXPORTER_HPP
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "DomeMesh.hpp"
+
+/**
+ * Binary PLY and glTF (.glb) writers for the warp mesh and the debug point sets.
+ *
+ * Every file is assembled in memory and written with a single call, so large
+ * point sets are bound by memory bandwidth rather than formatting. PLY files
+ * keep the byte order of the host and say so in their header, glb files are
+ * always little endian.
+ */
+namespace exporter {
+
+    /**
+     * Named set of points which ends up as its own node in a glb file.
+     * The points are referenced, not copied.
+     */
+    struct PointSet {
+
+        PointSet(std::string const &name, std::vector<glm::vec3> const &points)
+                : name(name)
+                , points(&points) {}
+
+        std::string name;
+        std::vector<glm::vec3> const *points;
+    };
+
+    /**
+     * Writes points as vertices without faces
+     * @param path
+     * @param points
+     * @return false if the file could not be written
+     */
+    bool writePointsPly(std::string const &path, std::vector<glm::vec3> const &points);
+
+    /**
+     * Writes the warp mesh with screen position on the z = 0 plane, texture coordinate and triangles
+     * @param path
+     * @param mesh
+     * @return false if the file could not be written
+     */
+    bool writeMeshPly(std::string const &path, DomeMesh const &mesh);
+
+    /**
+     * Writes the warp mesh and each point set as separate nodes of a single glb scene
+     * @param path
+     * @param mesh
+     * @param point_sets
+     * @return false if the file could not be written
+     */
+    bool writeGlb(std::string const &path, DomeMesh const &mesh, std::vector<PointSet> const &point_sets);
+}
+
+
+#endif //RAYCAST_EXPORTER_HPP
@@ -0,0 +1,106 @@
+#ifndef RAYCAST_FRAMEPROFILER_HPP
+#define RAYCAST_FRAMEPROFILER_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+/**
+ * Records cpu frame times split into phases and the gpu time of every frame.
+ *
+ * Gpu times come from GL_TIME_ELAPSED queries kept in a small ring. A query
+ * only gets read once its result is available, a few frames later, so the
+ * profiler never waits for the gpu. Percentiles cover the last frames within
+ * a rolling window, the json dump adds a histogram of the same window.
+ */
+class FrameProfiler {
+
+public:
+
+    /**
+     * @param window_size number of frames the statistics cover
+     */
+    explicit FrameProfiler(unsigned long window_size);
+
+    /**
+     * Creates the timer queries, gpu times stay empty if they are not supported
+     */
+    void initialize();
+
+    /**
+     * Adds a cpu phase, has to happen before the first frame
+     * @param name
+     * @return index of the phase
+     */
+    int addPhase(std::string const &name);
+
+    /**
+     * Starts a frame and its gpu timer, collects finished timers of earlier frames
+     */
+    void beginFrame();
+
+    /**
+     * Charges the time since the frame start or the previous mark to a phase
+     * @param phase_idx
+     */
+    void mark(int phase_idx);
+
+    /**
+     * Stops the gpu timer of the frame
+     */
+    void endFrame();
+
+    /**
+     * Single line with the percentiles of the frame and gpu times
+     * @return
+     */
+    std::string summary() const;
+
+    /**
+     * Writes percentiles and histograms of all timings
+     * @param file_path
+     * @return false if the file could not be written
+     */
+    bool writeJson(std::string const &file_path) const;
+
+    /**
+     * Deletes the timer queries, has to be called while the context is still alive
+     */
+    void release();
+
+private:
+
+    /**
+     * Rolling window of timings in milliseconds
+     */
+    struct Series {
+        std::string name;
+        std::vector<float> samples;
+        unsigned long next;
+        unsigned long total_count;
+        float max;
+
+        void add(float ms, unsigned long window_size);
+        float percentile(float p) const;
+    };
+
+    unsigned long _window_size;
+
+    // frame to frame time, gpu time, then the phases
+    std::vector<Series> _series;
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point _frame_start;
+    Clock::time_point _last_mark;
+    bool _has_frame;
+
+    std::vector<GLuint> _queries;
+    std::vector<bool> _query_pending;
+    unsigned long _query_idx;
+    bool _query_running;
+};
+
+
+#endif //RAYCAST_FRAMEPROFILER_HPP
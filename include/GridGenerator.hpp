@@ -0,0 +1,119 @@
+#ifndef RAYCAST_GRIDGENERATOR_HPP
+#define RAYCAST_GRIDGENERATOR_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * Sample positions on the projectors near plane, relative to its center.
+ *
+ * Coordinates are kept as separate x and y arrays. Structured layouts store
+ * their samples row by row, optionally preceded by a single center sample.
+ */
+struct SampleGrid {
+
+    SampleGrid();
+
+    /**
+     * Index of the sample in the given row and column
+     * @param row
+     * @param column
+     * @return
+     */
+    int index(int row, int column) const;
+
+    /**
+     * Whether the samples have a row and column topology
+     * @return
+     */
+    bool structured() const;
+
+    unsigned long size() const;
+
+    std::vector<float> x;
+    std::vector<float> y;
+
+    // rows are the rings of radial layouts and wrap around at their last column
+    int rows;
+    int columns;
+    bool has_center;
+    bool wraps;
+};
+
+
+class GridGenerator {
+
+public:
+
+    /**
+     * POLAR places rings at equal radial steps.
+     * CONCENTRIC places rings so every ring segment covers the same area.
+     * RECTANGULAR covers the near plane in rows and columns.
+     * HALTON and SOBOL spread low discrepancy points over the near plane.
+     * PIXEL hits the projector pixel centers, optionally every n-th pixel only.
+     */
+    enum Layout {
+        POLAR, CONCENTRIC, RECTANGULAR, HALTON, SOBOL, PIXEL
+    };
+
+    /**
+     * Creates a generator for the given layout.
+     * Rows and columns are rings and ring elements for the radial layouts,
+     * the low discrepancy layouts generate rows * columns points.
+     * @param layout
+     * @param rows
+     * @param columns
+     */
+    GridGenerator(Layout layout, int rows, int columns);
+
+    /**
+     * Creates a generator sampling every stride-th pixel of a projector image
+     * @param pixel_width
+     * @param pixel_height
+     * @param pixel_stride
+     * @return
+     */
+    static GridGenerator pixelAligned(int pixel_width, int pixel_height, int pixel_stride);
+
+    /**
+     * Generates the samples for a near plane of the given half extents
+     * @param half_width
+     * @param half_height
+     * @param grid
+     */
+    void generate(float half_width, float half_height, SampleGrid *grid) const;
+
+    /**
+     * Parses a layout name as used in model.json
+     * @param name
+     * @param layout
+     * @return false for unknown names
+     */
+    static bool parseLayout(std::string const &name, Layout *layout);
+
+    Layout get_layout() const;
+    int get_rows() const;
+    int get_columns() const;
+    int get_pixel_stride() const;
+
+private:
+
+    void generateRadial(float radius, SampleGrid *grid) const;
+
+    void generateRectangular(float half_width, float half_height, SampleGrid *grid) const;
+
+    void generateLowDiscrepancy(float half_width, float half_height, SampleGrid *grid) const;
+
+    void generatePixelAligned(float half_width, float half_height, SampleGrid *grid) const;
+
+    Layout _layout;
+    int _rows;
+    int _columns;
+
+    int _pixel_width;
+    int _pixel_height;
+    int _pixel_stride;
+};
+
+
+#endif //RAYCAST_GRIDGENERATOR_HPP
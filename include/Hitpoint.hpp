@@ -21,6 +21,12 @@ public:
     glm::vec3 position;
     glm::vec3 normal;
     double t;
+
+    // change of position and normal per pixel step, only set for rays carrying differentials
+    glm::vec3 position_dx;
+    glm::vec3 position_dy;
+    glm::vec3 normal_dx;
+    glm::vec3 normal_dy;
 };
 
 
@@ -0,0 +1,49 @@
+#ifndef RAYCAST_IMAGE_HPP
+#define RAYCAST_IMAGE_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * 8 bit rgb image, rows stored top to bottom without padding.
+ */
+struct Image {
+
+    Image();
+
+    Image(int width, int height);
+
+    /**
+     * Resizes the image, keeps the memory if the size did not change
+     * @param width
+     * @param height
+     */
+    void resize(int width, int height);
+
+    unsigned char *row(int y);
+    unsigned char const *row(int y) const;
+
+    /**
+     * Reads a binary (P6) ppm with a maximum value of 255
+     * @param path
+     * @param image
+     * @return false if the file could not be read
+     */
+    static bool readPpm(std::string const &path, Image *image);
+
+    /**
+     * Writes a binary (P6) ppm
+     * @param path
+     * @return false if the file could not be written
+     */
+    bool writePpm(std::string const &path) const;
+
+    static const int CHANNELS = 3;
+
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+
+#endif //RAYCAST_IMAGE_HPP
@@ -0,0 +1,89 @@
+#ifndef RAYCAST_INSTANCEDPOINTS_HPP
+#define RAYCAST_INSTANCEDPOINTS_HPP
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "BufferManager.hpp"
+#include "ResultView.hpp"
+
+/**
+ * Draws sets of points as small markers, every set with a single instanced draw call.
+ *
+ * All sets share one marker shape. The positions of all sets are streamed
+ * into the regions of a buffer manager and only uploaded when the sets change,
+ * so the cost of a frame does not grow with the number of points.
+ */
+class InstancedPoints {
+
+public:
+
+    InstancedPoints();
+
+    /**
+     * Loads the marker shader and remembers the marker shape
+     * @param stream_buffers receives the positions of all sets
+     * @param marker_buffer_id vertex buffer holding the triangles of a single marker
+     * @param num_marker_vertices
+     * @param vertex_file_path
+     * @param fragment_file_path
+     * @return false if the shader could not be loaded
+     */
+    bool initialize(BufferManager *stream_buffers, GLuint marker_buffer_id, int num_marker_vertices,
+                    char const *vertex_file_path, char const *fragment_file_path);
+
+    /**
+     * Adds an empty set drawn in the given color
+     * @param color
+     * @return index of the set
+     */
+    int addSet(glm::vec3 const &color);
+
+    /**
+     * Replaces the points of a set by writing them to the current region of the
+     * stream buffers, every set has to be uploaded again after beginUpload()
+     * @param set_idx
+     * @param points
+     */
+    void upload(int set_idx, ResultView<glm::vec3> const &points);
+
+    void set_visible(int set_idx, bool visible);
+    bool is_visible(int set_idx) const;
+
+    /**
+     * Draws all visible sets
+     * @param mvp
+     * @param marker_size scale of the marker shape
+     */
+    void draw(glm::mat4 const &mvp, float marker_size) const;
+
+    /**
+     * Deletes all gl objects, has to be called while the context is still alive
+     */
+    void release();
+
+private:
+
+    struct PointSet {
+        GLuint vertex_array_id;
+        GLsizei num_points;
+        glm::vec3 color;
+        bool visible;
+    };
+
+    GLuint _program_id;
+    GLint _mvp_location;
+    GLint _marker_size_location;
+    GLint _color_location;
+
+    BufferManager *_stream_buffers;
+    GLuint _marker_buffer_id;
+    GLsizei _num_marker_vertices;
+
+    std::vector<PointSet> _sets;
+};
+
+
+#endif //RAYCAST_INSTANCEDPOINTS_HPP
@@ -0,0 +1,115 @@
+#ifndef RAYCAST_INTERREFLECTION_HPP
+#define RAYCAST_INTERREFLECTION_HPP
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ResultView.hpp"
+#include "Sphere.hpp"
+#include "SpatialGrid.hpp"
+
+/**
+ * Monte Carlo estimate of the light scattered back onto the dome.
+ *
+ * Every second hit starts a path carrying an equal share of the projected
+ * light. The path bounces diffusely inside the dome sphere and leaves at
+ * the equator, where the floor is taken to absorb it. Direct and scattered
+ * light are deposited on the nearest vertex of the dome tessellation.
+ *
+ * Each refinement pass traces one more path per hit. The paths follow a
+ * Halton sequence over the passes, shifted per hit, so early passes already
+ * spread evenly over the hemisphere.
+ */
+class InterReflection {
+
+public:
+
+    InterReflection();
+
+    /**
+     * Prepares the tessellation and the direct irradiance, drops all previous passes
+     * @param dome
+     * @param vertices dome vertices
+     * @param indices triangles of the dome vertices
+     * @param hits second hits, lost rays get skipped
+     * @param albedo diffuse reflectance of the dome surface
+     * @param max_bounces
+     */
+    void setup(Sphere const &dome, ResultView<glm::vec3> const &vertices, std::vector<unsigned int> const &indices,
+               ResultView<glm::vec3> const &hits, float albedo, int max_bounces);
+
+    /**
+     * Traces one path from every hit on all cores
+     * @return estimated relative error of the scattered irradiance
+     */
+    float refine();
+
+    /**
+     * Refines until the error drops below the tolerance, reporting every pass
+     * @param tolerance relative error
+     * @param max_passes
+     * @param max_seconds
+     * @return false if the tolerance was not reached
+     */
+    bool estimate(float tolerance, int max_passes, double max_seconds);
+
+    /**
+     * Writes the irradiance of every vertex and the summary as json
+     * @param file_path
+     * @return
+     */
+    bool writeJson(std::string const &file_path) const;
+
+    /**
+     * Scattered over direct light, averaged over the dome area
+     * @return
+     */
+    float strayRatio() const;
+
+    // irradiance per vertex, the projected light in total is 1
+    std::vector<float> const &get_direct() const;
+    std::vector<float> get_indirect() const;
+
+    int get_num_passes() const;
+    float get_error() const;
+
+private:
+
+    /**
+     * Index of the vertex closest to a point on the dome
+     * @param point
+     * @return
+     */
+    int nearestVertex(glm::vec3 const &point) const;
+
+    /**
+     * Follows the bounces of one path, adding its light to the given sums
+     * @param hit_idx
+     * @param pass
+     * @param sums
+     */
+    void tracePath(unsigned long hit_idx, unsigned int pass, std::vector<double> *sums) const;
+
+    glm::vec3 _center;
+    float _radius;
+    float _albedo;
+    int _max_bounces;
+
+    std::vector<glm::vec3> _vertices;
+    std::vector<float> _vertex_areas;
+    SpatialGrid _vertex_grid;
+
+    std::vector<glm::vec3> _hits;
+    std::vector<float> _direct;
+
+    // scattered light of the even and odd passes, the difference tells the error
+    std::vector<double> _even_sums;
+    std::vector<double> _odd_sums;
+    int _num_passes;
+    float _error;
+};
+
+
+#endif //RAYCAST_INTERREFLECTION_HPP
@@ -0,0 +1,86 @@
+#ifndef RAYCAST_MAPPINGMETRICS_HPP
+#define RAYCAST_MAPPINGMETRICS_HPP
+
+#include <vector>
+#include <ostream>
+
+/**
+ * Quality metrics of a single mapping run.
+ *
+ * Ray losses are collected while casting, snap distances and the ring density
+ * while building the transformation mesh. Both only add counters to loops that
+ * run anyway.
+ */
+struct MappingMetrics {
+
+    MappingMetrics();
+
+    /**
+     * Clears the ray counters and sizes the per ring density table.
+     * @param dome_rings
+     */
+    void resetRays(int dome_rings);
+
+    /**
+     * Clears the snap counters and sizes the histogram.
+     * @param tolerance
+     * @param num_bins
+     */
+    void resetSnaps(float tolerance, int num_bins);
+
+    /**
+     * Sorts a snap distance into the histogram.
+     * Distances beyond the last bin end up in the last bin.
+     * @param distance
+     */
+    void addSnap(float distance);
+
+    /**
+     * Counts a dome vertex without any valid hit to snap to.
+     */
+    void addUnmapped();
+
+    /**
+     * Percentage of dome vertices having a hit within the snap tolerance.
+     * @return
+     */
+    float coverage() const;
+
+    /**
+     * Fraction of all rays of the given counter.
+     * @param count
+     * @return
+     */
+    float rayFraction(unsigned int count) const;
+
+    friend std::ostream &operator<<(std::ostream &os, const MappingMetrics &metrics);
+
+    // ray losses
+    unsigned int num_rays;
+    unsigned int num_mirror_misses;
+    unsigned int num_dome_misses;
+    unsigned int num_below_equator;
+
+    // hits per dome ring band and hits per square unit of that band
+    std::vector<unsigned int> ring_hits;
+    std::vector<float> ring_hit_density;
+
+    // snapping of dome vertices to their hitpoints
+    float tolerance;
+    float histogram_bin_width;
+    std::vector<unsigned int> snap_histogram;
+
+    unsigned int num_vertices;
+    unsigned int num_covered_vertices;
+    unsigned int num_unmapped_vertices;
+
+    float mean_snap_distance;
+    float max_snap_distance;
+
+    // cost of the nearest hit searches
+    unsigned long num_distance_evaluations;
+    unsigned int num_walk_fallbacks;
+};
+
+
+#endif //RAYCAST_MAPPINGMETRICS_HPP
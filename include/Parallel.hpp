@@ -0,0 +1,59 @@
+#ifndef RAYCAST_PARALLEL_HPP
+#define RAYCAST_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+    /**
+     * Number of worker threads used for parallel loops
+     * @return
+     */
+    inline unsigned int numThreads() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /**
+     * Calls fn(tile_begin, tile_end) for consecutive tiles of [begin, end).
+     * Tiles are handed out to all cores on demand, so uneven tiles balance out.
+     * @param begin
+     * @param end
+     * @param tile_size
+     * @param fn
+     */
+    template<typename Function>
+    void forTiles(long begin, long end, long tile_size, Function fn) {
+
+        if (end <= begin) {
+            return;
+        }
+
+        tile_size = std::max(tile_size, 1L);
+        long num_tiles = (end - begin + tile_size - 1) / tile_size;
+        unsigned int num_workers = (unsigned int) std::min<long>(numThreads(), num_tiles);
+
+        std::atomic<long> next_tile(0);
+        auto work = [&]() {
+            for (long tile = next_tile++; tile < num_tiles; tile = next_tile++) {
+                long tile_begin = begin + tile * tile_size;
+                fn(tile_begin, std::min(tile_begin + tile_size, end));
+            }
+        };
+
+        // the calling thread takes its share as well
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < num_workers; ++i) {
+            workers.emplace_back(work);
+        }
+        work();
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+}
+
+#endif //RAYCAST_PARALLEL_HPP
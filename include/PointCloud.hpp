@@ -0,0 +1,92 @@
+#ifndef RAYCAST_POINTCLOUD_HPP
+#define RAYCAST_POINTCLOUD_HPP
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "BufferManager.hpp"
+#include "PointOctree.hpp"
+
+/**
+ * Draws full resolution point sets within a fixed number of points per frame.
+ *
+ * The points of every cloud get streamed into the regions of a buffer manager
+ * once per model, in the order of their octree.
+ * Each frame picks the octree nodes with the largest projected size and draws
+ * their point ranges with a single glMultiDrawArrays call per cloud, so close
+ * regions show every point while distant ones stay coarse.
+ */
+class PointCloud {
+
+public:
+
+    PointCloud();
+
+    /**
+     * Loads the point shader
+     * @param stream_buffers receives the points of all clouds
+     * @param vertex_file_path
+     * @param fragment_file_path
+     * @return false if the shader could not be loaded
+     */
+    bool initialize(BufferManager *stream_buffers, char const *vertex_file_path, char const *fragment_file_path);
+
+    /**
+     * Adds an empty cloud drawn in the given color
+     * @param color
+     * @return index of the cloud
+     */
+    int addCloud(glm::vec3 const &color);
+
+    /**
+     * Replaces the points of a cloud by writing them to the current region of the
+     * stream buffers, every cloud has to be uploaded again after beginUpload().
+     * The octree is used for every following draw and has to stay alive until the next upload.
+     * @param cloud_idx
+     * @param octree
+     */
+    void upload(int cloud_idx, PointOctree const *octree);
+
+    void set_visible(int cloud_idx, bool visible);
+    bool is_visible(int cloud_idx) const;
+
+    /**
+     * Draws all visible clouds, sharing the point budget evenly
+     * @param mvp
+     * @param point_budget maximum number of points drawn in total
+     * @param point_size in pixels
+     * @return number of drawn points
+     */
+    unsigned long draw(glm::mat4 const &mvp, unsigned long point_budget, float point_size);
+
+    /**
+     * Deletes all gl objects, has to be called while the context is still alive
+     */
+    void release();
+
+private:
+
+    struct Cloud {
+        GLuint vertex_array_id;
+        PointOctree const *octree;
+        glm::vec3 color;
+        bool visible;
+    };
+
+    GLuint _program_id;
+    GLint _mvp_location;
+    GLint _point_size_location;
+    GLint _color_location;
+
+    BufferManager *_stream_buffers;
+    std::vector<Cloud> _clouds;
+
+    // draw ranges of the current frame, kept to avoid reallocations
+    std::vector<GLint> _firsts;
+    std::vector<GLsizei> _counts;
+};
+
+
+#endif //RAYCAST_POINTCLOUD_HPP
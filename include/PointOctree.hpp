@@ -0,0 +1,87 @@
+#ifndef RAYCAST_POINTOCTREE_HPP
+#define RAYCAST_POINTOCTREE_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ResultView.hpp"
+
+/**
+ * Level of detail hierarchy over a point set.
+ *
+ * Every node keeps a spatially even sample of the points within its box and
+ * hands the remaining ones down to its children. The points are reordered so
+ * the sample of every node is one contiguous range. Drawing a node adds detail
+ * to everything drawn for its ancestors, so any subtree rooted at the root node
+ * is a valid coarse version of the whole set.
+ */
+class PointOctree {
+
+public:
+
+    struct Node {
+        glm::vec3 box_min;
+        glm::vec3 box_max;
+
+        // range of the nodes own points
+        unsigned int first;
+        unsigned int count;
+
+        // -1 for missing children
+        int children[8];
+    };
+
+    PointOctree();
+
+    /**
+     * Builds the hierarchy
+     * @param points
+     * @param node_capacity maximum number of points kept by a single node
+     */
+    void build(ResultView<glm::vec3> const &points, unsigned int node_capacity);
+
+    /**
+     * Builds the hierarchy over a subset of the points, the rest never gets copied
+     * @param points
+     * @param indices points to include
+     * @param node_capacity maximum number of points kept by a single node
+     */
+    void build(ResultView<glm::vec3> const &points, std::vector<unsigned int> indices, unsigned int node_capacity);
+
+    /**
+     * Picks the nodes with the largest projected size until the point budget is used up.
+     * Nodes outside the view get skipped along with their subtrees.
+     * @param mvp
+     * @param point_budget
+     * @param firsts receives the first point of every picked node
+     * @param counts receives the number of points of every picked node
+     * @return number of picked points
+     */
+    unsigned long select(glm::mat4 const &mvp, unsigned long point_budget,
+                         std::vector<int> *firsts, std::vector<int> *counts) const;
+
+    std::vector<glm::vec3> const &get_points() const;
+    std::vector<Node> const &get_nodes() const;
+
+private:
+
+    /**
+     * Builds the node for the given points, returns its index
+     * @param indices points within the node, in arbitrary order
+     * @param box_min
+     * @param box_max
+     * @param depth
+     * @param source
+     * @return
+     */
+    int buildNode(std::vector<unsigned int> &indices, glm::vec3 const &box_min, glm::vec3 const &box_max,
+                  int depth, ResultView<glm::vec3> const &source);
+
+    std::vector<glm::vec3> _points;
+    std::vector<Node> _nodes;
+    unsigned int _node_capacity;
+};
+
+
+#endif //RAYCAST_POINTOCTREE_HPP
@@ -8,6 +8,8 @@
 #include <glm/glm.hpp>
 #include <ostream>
 
+#include "Hitpoint.hpp"
+
 struct Ray {
 
     Ray();
@@ -16,13 +18,38 @@ struct Ray {
     Ray(const Ray& ray);
     ~Ray();
 
+    /**
+     * Attaches the change of origin and direction per pixel step along x and y
+     * @param origin_dx
+     * @param origin_dy
+     * @param direction_dx
+     * @param direction_dy
+     */
+    void setDifferentials(glm::vec3 const &origin_dx, glm::vec3 const &origin_dy,
+                          glm::vec3 const &direction_dx, glm::vec3 const &direction_dy);
 
     glm::vec3 reflect(glm::vec3 const& normal) const;
+
+    /**
+     * Reflects the ray at the hitpoint, starting the new ray there.
+     * Differentials follow the change of the hitpoints normal.
+     * @param hit hitpoint with a unit normal
+     * @return
+     */
+    Ray reflectAt(Hitpoint const &hit) const;
+
     friend std::ostream &operator<<(std::ostream &os, const Ray &ray);
 
     // members
     glm::vec3 origin;
     glm::vec3 direction;
+
+    // ray differentials after Igehy, the offsets of the rays through the neighbouring pixels
+    bool has_differentials;
+    glm::vec3 origin_dx;
+    glm::vec3 origin_dy;
+    glm::vec3 direction_dx;
+    glm::vec3 direction_dy;
 };
 
 #endif //RAYCAST_RAY_H
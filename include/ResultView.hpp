@@ -0,0 +1,75 @@
+#ifndef RAYCAST_RESULTVIEW_HPP
+#define RAYCAST_RESULTVIEW_HPP
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Read-only window onto a buffer owned by someone else.
+ *
+ * Views of the projectors results carry the generation of the calculation
+ * that produced them. A view stays valid until its owner recalculates, which
+ * bumps the generation, so comparing both tells whether the view went stale.
+ * Views of plain vectors have generation 0, which lets any vector be passed
+ * where a view is expected.
+ */
+template<typename T>
+class ResultView {
+
+public:
+
+    ResultView()
+            : _data(nullptr)
+            , _size(0)
+            , _generation(0) {}
+
+    ResultView(std::vector<T> const &values)
+            : _data(values.data())
+            , _size(values.size())
+            , _generation(0) {}
+
+    ResultView(std::vector<T> const &values, unsigned long generation)
+            : _data(values.data())
+            , _size(values.size())
+            , _generation(generation) {}
+
+    // a view of a temporary would dangle right away
+    ResultView(std::vector<T> &&values) = delete;
+    ResultView(std::vector<T> &&values, unsigned long generation) = delete;
+
+    T const *begin() const {
+        return this->_data;
+    }
+
+    T const *end() const {
+        return this->_data + this->_size;
+    }
+
+    T const *data() const {
+        return this->_data;
+    }
+
+    T const &operator[](size_t idx) const {
+        return this->_data[idx];
+    }
+
+    size_t size() const {
+        return this->_size;
+    }
+
+    bool empty() const {
+        return this->_size == 0;
+    }
+
+    unsigned long get_generation() const {
+        return this->_generation;
+    }
+
+private:
+    T const *_data;
+    size_t _size;
+    unsigned long _generation;
+};
+
+
+#endif //RAYCAST_RESULTVIEW_HPP
@@ -5,9 +5,19 @@
 #ifndef RAYCAST_SHADERUTIL_HPP
 #define RAYCAST_SHADERUTIL_HPP
 
+#include <string>
+
 #include <GL/glew.h>
 
 GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path);
 
+/**
+ * Keeps the binaries of linked programs in the given directory and loads them
+ * instead of compiling on later launches. Binaries are keyed on the shader
+ * sources and the driver, rejected ones get compiled and replaced.
+ * @param directory created if missing, empty turns the cache off
+ */
+void SetProgramCacheDirectory(std::string const &directory);
+
 
 #endif //RAYCAST_SHADERUTIL_HPP
@@ -0,0 +1,185 @@
+#ifndef RAYCAST_SHAREDMESH_HPP
+#define RAYCAST_SHAREDMESH_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "DomeMesh.hpp"
+
+/**
+ * Layout of the shared memory region a published warp mesh lives in.
+ *
+ * The region starts with a SharedMeshHeader followed by num_slots slots of
+ * slot_bytes each. A slot starts with its SharedMeshSlot header, followed by
+ * the interleaved vertices and the indices of its mesh.
+ *
+ * Every slot is guarded by a sequence lock: the sequence is odd while the
+ * publisher writes into the slot and increases by two with every mesh. Readers
+ * copy the slot and retry if the sequence changed meanwhile, so they never see
+ * torn meshes and never block the publisher. The publisher cycles through the
+ * slots and never touches the latest one, so a reader usually succeeds at once.
+ * Readers that can use the mesh in place take a SharedMeshView instead of a copy
+ * and validate it once they are done.
+ */
+struct SharedMeshHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t slot_bytes;
+    uint32_t max_vertices;
+    uint32_t max_indices;
+
+    // slot holding the newest complete mesh
+    std::atomic<uint32_t> latest_slot;
+
+    // futex word, increased after every published mesh and on closing
+    std::atomic<uint32_t> notify;
+
+    // set before the publisher unlinks the region, readers reopen the name to follow a new one
+    std::atomic<uint32_t> closed;
+};
+
+struct SharedMeshSlot {
+    std::atomic<uint32_t> sequence;
+    uint32_t index_bytes;
+    uint32_t num_vertices;
+    uint32_t num_indices;
+    uint64_t frame;
+};
+
+
+/**
+ * Read-only view of a mesh inside the shared memory region.
+ *
+ * The pointers lead straight into the mapped slot, which the publisher may
+ * reuse at any time. Whatever a reader derives from the view only counts once
+ * SharedMeshSubscriber::validate confirms the slot was left untouched meanwhile.
+ */
+struct SharedMeshView {
+    float const *vertices;
+    void const *indices;
+    uint32_t index_bytes;
+    uint32_t num_vertices;
+    uint32_t num_indices;
+    uint64_t frame;
+
+    // slot and sequence the view got acquired at
+    uint32_t slot;
+    uint32_t sequence;
+};
+
+
+/**
+ * Writes finished meshes into a POSIX shared memory region. Linux only.
+ */
+class SharedMeshPublisher {
+
+public:
+
+    SharedMeshPublisher();
+
+    ~SharedMeshPublisher();
+
+    /**
+     * Creates or replaces the shared memory region
+     * @param name posix shared memory name, starting with a slash
+     * @param num_slots at least two, three avoids readers retrying
+     * @param max_vertices
+     * @param max_indices
+     * @return false if the region could not be created
+     */
+    bool open(std::string const &name, int num_slots, unsigned long max_vertices, unsigned long max_indices);
+
+    /**
+     * Marks the region closed, wakes up all waiting readers, then unmaps and removes it
+     */
+    void close();
+
+    /**
+     * Copies the mesh into the next slot and wakes up all waiting readers
+     * @param mesh
+     * @return false if the region is not open or the mesh exceeds its capacity
+     */
+    bool publish(DomeMesh const &mesh);
+
+    bool is_open() const;
+
+private:
+
+    std::string _name;
+    void *_region;
+    unsigned long _region_bytes;
+    uint64_t _frame;
+};
+
+
+/**
+ * Maps a region created by SharedMeshPublisher read-only. Linux only.
+ */
+class SharedMeshSubscriber {
+
+public:
+
+    SharedMeshSubscriber();
+
+    ~SharedMeshSubscriber();
+
+    /**
+     * Maps an existing shared memory region
+     * @param name
+     * @return false if the region does not exist or does not hold meshes
+     */
+    bool open(std::string const &name);
+
+    void close();
+
+    /**
+     * Blocks until a mesh newer than the given notify count got published or the region got closed
+     * @param last_notify notify count returned by the previous read
+     * @param timeout_ms
+     * @return false on timeout
+     */
+    bool wait(uint32_t last_notify, int timeout_ms) const;
+
+    /**
+     * Points the view at the newest mesh without copying it.
+     * Gives up after a while if the publisher stopped in the middle of a mesh.
+     * @param view
+     * @param notify set to the notify count the mesh belongs to, or the current one on failure
+     * @return false if nothing got published yet or the newest slot stays half written
+     */
+    bool acquire(SharedMeshView *view, uint32_t *notify) const;
+
+    /**
+     * Checks whether the publisher left the slot of the view alone since it got acquired
+     * @param view
+     * @return false if data read through the view may be torn
+     */
+    bool validate(SharedMeshView const &view) const;
+
+    /**
+     * Copies the newest mesh
+     * @param mesh
+     * @param frame set to the number of the mesh, counting from one
+     * @param notify set to the notify count the mesh belongs to
+     * @return false if nothing got published yet or the newest slot stays half written
+     */
+    bool read(DomeMesh *mesh, uint64_t *frame, uint32_t *notify) const;
+
+    /**
+     * Checks whether the publisher closed the region, a new one may have replaced it under the same name
+     * @return
+     */
+    bool is_closed() const;
+
+    bool is_open() const;
+
+private:
+
+    void const *_region;
+    unsigned long _region_bytes;
+};
+
+
+#endif //RAYCAST_SHAREDMESH_HPP
@@ -0,0 +1,73 @@
+#ifndef RAYCAST_SPATIALGRID_HPP
+#define RAYCAST_SPATIALGRID_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Uniform grid over a set of axis aligned boxes.
+ *
+ * Every box is referenced by all cells it overlaps. The cell lists are stored
+ * back to back in a single index array so a lookup is one division and two reads.
+ */
+class SpatialGrid {
+
+public:
+
+    /**
+     * Creates an empty grid
+     */
+    SpatialGrid();
+
+    /**
+     * Builds the grid for the given boxes. The i-th box is referenced as i.
+     * @param box_min
+     * @param box_max
+     * @param cells_per_axis
+     */
+    void build(std::vector<glm::vec3> const &box_min, std::vector<glm::vec3> const &box_max, int cells_per_axis);
+
+    /**
+     * Returns the boxes referenced by the cell containing the given point.
+     * Both pointers are equal if the point lies outside the grid or the cell is empty.
+     * @param point
+     * @param begin
+     * @param end
+     */
+    void query(glm::vec3 const &point, int const **begin, int const **end) const;
+
+    /**
+     * Collects the boxes referenced by all cells overlapping the given box.
+     * Boxes spanning several of those cells are collected more than once.
+     * @param box_min
+     * @param box_max
+     * @param result
+     */
+    void query(glm::vec3 const &box_min, glm::vec3 const &box_max, std::vector<int> *result) const;
+
+    bool empty() const;
+
+private:
+
+    /**
+     * Returns the cell coordinate of a point along all axes, clamped to the grid
+     * @param point
+     * @return
+     */
+    glm::vec3 cellCoord(glm::vec3 const &point) const;
+
+    int cellIndex(int x, int y, int z) const;
+
+    glm::vec3 _min;
+    glm::vec3 _max;
+    glm::vec3 _cell_size;
+    int _cells_per_axis;
+
+    // cell i references _indices[_offsets[i]] .. _indices[_offsets[i + 1]]
+    std::vector<int> _offsets;
+    std::vector<int> _indices;
+};
+
+
+#endif //RAYCAST_SPATIALGRID_HPP
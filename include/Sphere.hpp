@@ -24,6 +24,30 @@ public:
     // methods
     bool intersect(Ray const &r, std::pair<Hitpoint, Hitpoint> *hp_pair);
 
+    /**
+     * Finds the closest hit in front of the ray origin, from inside the sphere that is the exit
+     * @param r
+     * @param hit
+     * @return false if the ray misses the sphere
+     */
+    bool intersectNear(Ray const &r, Hitpoint *hit) const;
+
+    /**
+     * Finds the furthest hit in front of the ray origin, the exit of the sphere
+     * @param r
+     * @param hit
+     * @return false if the ray misses the sphere
+     */
+    bool intersectFar(Ray const &r, Hitpoint *hit) const;
+
+    /**
+     * Checks whether the sphere blocks the ray within the given distance
+     * @param r
+     * @param max_t distance in multiples of the rays direction
+     * @return
+     */
+    bool occludes(Ray const &r, float max_t) const;
+
     // getter
     float get_radius() const;
     glm::vec3 get_position() const;
@@ -37,6 +61,32 @@ public:
 
 
 private:
+
+    /**
+     * Solves for both distances along the ray at which it crosses the sphere
+     * @param r
+     * @param t_near
+     * @param t_far
+     * @return false if the ray misses the sphere
+     */
+    bool solve(Ray const &r, float *t_near, float *t_far) const;
+
+    /**
+     * Fills position and normal of the hit at distance t
+     * @param r
+     * @param t
+     * @param hit
+     */
+    void fillHit(Ray const &r, float t, Hitpoint *hit) const;
+
+    /**
+     * Moves the rays differentials onto the hitpoint at distance t
+     * @param r
+     * @param hit hitpoint with position and normal set
+     * @param t
+     */
+    void transferDifferentials(Ray const &r, Hitpoint *hit, float t) const;
+
     float _radius;
     glm::vec3 _center;
 
@@ -25,6 +25,8 @@ namespace utility {
     glm::vec3 findMinValues(std::vector<glm::vec3> vector);
 
     glm::vec3 findMaxValues(std::vector<glm::vec3> vector);
+
+    float radicalInverse(unsigned int index, unsigned int base);
 }
 
 #endif //RAYCAST_UTILITY_HPP
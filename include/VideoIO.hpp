@@ -0,0 +1,130 @@
+#ifndef RAYCAST_VIDEOIO_HPP
+#define RAYCAST_VIDEOIO_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Image.hpp"
+
+/**
+ * Frame sequences as raw rgb24 or yuv4mpeg2 (y4m), read from and written to files or pipes.
+ *
+ * y4m input may use 4:2:0 or 4:4:4 chroma, y4m output is always 4:4:4 so the
+ * warp does not lose color resolution. The yuv conversion uses BT.601 with
+ * limited range. A path of "-" stands for stdin or stdout.
+ *
+ * Reading and writing only move the bytes of a frame, converting them from
+ * and to rgb is separate and safe to run on several threads at once.
+ */
+namespace video {
+
+    enum Format {
+        RAW_RGB, Y4M
+    };
+
+    class Reader {
+
+    public:
+
+        Reader();
+
+        ~Reader();
+
+        /**
+         * Opens a y4m stream, the frame size comes from its header
+         * @param path
+         * @return false if the stream could not be opened or has an unsupported header
+         */
+        bool openY4m(std::string const &path);
+
+        /**
+         * Opens a raw rgb24 stream of the given frame size
+         * @param path
+         * @param width
+         * @param height
+         * @return false if the stream could not be opened
+         */
+        bool openRaw(std::string const &path, int width, int height);
+
+        /**
+         * Reads the bytes of the next frame
+         * @param packet
+         * @return false at the end of the stream
+         */
+        bool read(std::vector<unsigned char> *packet);
+
+        /**
+         * Converts the bytes of a frame to rgb
+         * @param packet
+         * @param frame resized to the frame size
+         */
+        void decode(std::vector<unsigned char> const &packet, Image *frame) const;
+
+        void close();
+
+        Format get_format() const;
+        int get_width() const;
+        int get_height() const;
+
+        /**
+         * Frame rate as given in the y4m header, e.g. "30:1"
+         * @return
+         */
+        std::string const &get_frame_rate() const;
+
+    private:
+
+        bool open(std::string const &path);
+
+        FILE *_file;
+        Format _format;
+        int _width;
+        int _height;
+        bool _chroma_420;
+        std::string _frame_rate;
+    };
+
+    class Writer {
+
+    public:
+
+        Writer();
+
+        ~Writer();
+
+        /**
+         * Opens the output and writes the stream header
+         * @param path
+         * @param format
+         * @param width
+         * @param height
+         * @param frame_rate y4m frame rate, e.g. "30:1"
+         * @return false if the output could not be opened
+         */
+        bool open(std::string const &path, Format format, int width, int height, std::string const &frame_rate);
+
+        /**
+         * Converts a frame to the bytes of the output format
+         * @param frame
+         * @param packet
+         */
+        void encode(Image const &frame, std::vector<unsigned char> *packet) const;
+
+        /**
+         * Appends the bytes of a frame
+         * @param packet
+         * @return false if writing failed
+         */
+        bool write(std::vector<unsigned char> const &packet);
+
+        void close();
+
+    private:
+
+        FILE *_file;
+        Format _format;
+    };
+}
+
+#endif //RAYCAST_VIDEOIO_HPP
@@ -0,0 +1,69 @@
+#ifndef RAYCAST_VIDEOPIPELINE_HPP
+#define RAYCAST_VIDEOPIPELINE_HPP
+
+#include <vector>
+
+#include "Image.hpp"
+#include "VideoIO.hpp"
+#include "WarpEngine.hpp"
+
+/**
+ * Warps a frame sequence in three stages: a reader thread, a set of workers
+ * that decode, warp and encode whole frames, and the calling thread writing
+ * the frames back in their original order.
+ *
+ * Frames travel in a fixed number of slots that get reused once written, so
+ * memory stays the same no matter how long the sequence is. A slow writer
+ * stalls the reader instead of piling up frames.
+ */
+class VideoPipeline {
+
+public:
+
+    /**
+     * @param engine prepared for the frame size of the input
+     * @param num_workers
+     */
+    VideoPipeline(WarpEngine const *engine, int num_workers);
+
+    /**
+     * Warps every frame of the reader into the writer
+     * @param reader
+     * @param writer
+     * @return false if a frame could not be warped or written
+     */
+    bool run(video::Reader *reader, video::Writer *writer);
+
+    unsigned long get_num_frames() const;
+
+    /**
+     * Frames per second of the last run
+     * @return
+     */
+    double get_fps() const;
+
+private:
+
+    /**
+     * All buffers a frame needs on its way through the pipeline
+     */
+    struct Slot {
+        unsigned long sequence;
+        bool failed;
+        std::vector<unsigned char> input;
+        Image source;
+        Image target;
+        std::vector<unsigned char> output;
+    };
+
+    WarpEngine const *_engine;
+    int _num_workers;
+
+    std::vector<Slot> _slots;
+
+    unsigned long _num_frames;
+    double _seconds;
+};
+
+
+#endif //RAYCAST_VIDEOPIPELINE_HPP
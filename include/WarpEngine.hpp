@@ -0,0 +1,115 @@
+#ifndef RAYCAST_WARPENGINE_HPP
+#define RAYCAST_WARPENGINE_HPP
+
+#include <vector>
+
+#include "DomeMesh.hpp"
+#include "Image.hpp"
+
+/**
+ * Applies the warp mesh to images on the cpu.
+ *
+ * The mesh gets rasterized once into a lookup table holding the texture
+ * coordinate of every projector pixel. For a given source resolution those
+ * turn into texel offsets and fixed point filter weights, so warping a frame
+ * only blends 2x2 texel blocks, in tiles of rows spread over all cores and
+ * with SSE2 doing the filtering where available.
+ *
+ * Screen positions of the mesh are normalized device coordinates with y up,
+ * texture coordinates map (0, 0) to the top left corner of the source image.
+ */
+class WarpEngine {
+
+public:
+
+    WarpEngine();
+
+    /**
+     * Rasterizes the mesh into the lookup table
+     * @param mesh
+     * @param width projector resolution
+     * @param height
+     */
+    void setMesh(DomeMesh const &mesh, int width, int height);
+
+    /**
+     * Prepares the lookup table for source images of the given size
+     * @param width at least 2
+     * @param height at least 2
+     */
+    void setSourceSize(int width, int height);
+
+    /**
+     * Warps a source image into a projector frame, pixels outside the mesh turn black.
+     * Safe to call from several threads at once.
+     * @param source sized as given to setSourceSize()
+     * @param target resized to the projector resolution
+     * @return false if the source size does not match
+     */
+    bool warp(Image const &source, Image *target) const;
+
+    /**
+     * Same as warp() but stays on the calling thread, for callers that spread whole frames over the cores
+     * @param source
+     * @param target
+     * @return false if the source size does not match
+     */
+    bool warpSingleThreaded(Image const &source, Image *target) const;
+
+    int get_width() const;
+    int get_height() const;
+
+    /**
+     * Number of projector pixels covered by the mesh
+     * @return
+     */
+    unsigned long numMappedPixels() const;
+
+private:
+
+    /**
+     * Warps the rows [row_begin, row_end)
+     * @param source
+     * @param target
+     * @param row_begin
+     * @param row_end
+     */
+    void warpRows(Image const &source, Image *target, int row_begin, int row_end) const;
+
+    /**
+     * Checks the source size and sizes the target
+     * @param source
+     * @param target
+     * @return false if the source size does not match
+     */
+    bool prepareTarget(Image const &source, Image *target) const;
+
+    /**
+     * Turns the texture coordinates into texels of the current source size
+     */
+    void updateTexels();
+
+    int _width;
+    int _height;
+
+    // texture coordinate of every pixel, negative where the mesh does not reach
+    std::vector<float> _lut_u;
+    std::vector<float> _lut_v;
+
+    /**
+     * Upper left texel of the 2x2 block a pixel gets filtered from
+     */
+    struct Texel {
+        // byte offset into the source pixels, negative where the mesh does not reach
+        int offset;
+        unsigned short weight_x;
+        unsigned short weight_y;
+    };
+
+    int _source_width;
+    int _source_height;
+    std::vector<Texel> _texels;
+};
+
+
+#endif //RAYCAST_WARPENGINE_HPP
@@ -2,7 +2,15 @@
 #include <vector>
 #include <map>
 #include <cmath>
+#include <cstdlib>
 #include <fstream>
+#include <csignal>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 // Include GLEW
 #include <GL/glew.h>
@@ -23,14 +31,21 @@
 #include "DomeProjector.hpp"
 #include "vertex_buffer_data.hpp"
 #include "projector_frustum.h"
+#include "SharedMesh.hpp"
+#include "CalibrationService.hpp"
+#include "ConfigWatcher.hpp"
+#include "InstancedPoints.hpp"
+#include "PointCloud.hpp"
+#include "PointOctree.hpp"
+#include "FrameProfiler.hpp"
+#include "BufferManager.hpp"
+#include "WarpEngine.hpp"
+#include "VideoPipeline.hpp"
+#include "InterReflection.hpp"
+#include "Parallel.hpp"
 
 // gl globals
 GLFWwindow *window;
-DomeProjector *dp;
-Frustum *frustum;
-Screen *screen;
-Sphere *mirror;
-Sphere *dome;
 
 
 int SCREEN_WIDTH = 1280;
@@ -42,18 +57,75 @@ std::vector<GLuint> vertex_buffer_ids;
 std::vector<GLuint> vertex_array_ids;
 std::vector<GLuint> shader_program_ids;
 
-std::map<std::string, GLuint> color_map;
+// marker sets, each drawn with a single instanced call
+enum MarkerSet {
+    CLIPPING_CORNER_MARKERS,
+    ORIGIN_MARKERS,
+    DOME_VERTEX_MARKERS,
+    SCREEN_POINT_MARKERS
+};
+
+InstancedPoints markers;
+
+// triple buffered vertex data of the markers and point clouds
+BufferManager stream_buffers;
+
+// full resolution point sets, drawn within the point budget
+enum PointCloudSet {
+    SAMPLE_GRID_POINTS,
+    FIRST_HIT_POINTS,
+    SECOND_HIT_POINTS
+};
+
+PointCloud point_clouds;
+
+// frame timings of the last 1000 frames
+FrameProfiler frame_profiler(1000);
+
+/**
+ * Everything calculated from one state of model.json.
+ * Published models are never changed again, the renderer keeps drawing the
+ * current one while its successor gets calculated in the background.
+ */
+struct Model {
+
+    Model()
+            : projector(nullptr)
+            , mirror(nullptr)
+            , dome(nullptr)
+            , frustum(nullptr) {}
+
+    ~Model() {
+        delete projector;
+        delete mirror;
+        delete dome;
+    }
+
+    // the projector owns the frustum
+    DomeProjector *projector;
+    Sphere *mirror;
+    Sphere *dome;
+    Frustum *frustum;
+
+    // drawables
+    std::vector<glm::vec3> far_clipping_corners;
+    std::vector<glm::vec3> near_clipping_corners;
+    PointOctree sample_grid_octree;
+    PointOctree first_hit_octree;
+    PointOctree second_hit_octree;
+};
+
+// only accessed through std::atomic_load and std::atomic_store
+std::shared_ptr<Model> current_model;
 
 // drawable globals
-std::vector<glm::vec3> far_clipping_corners;
-std::vector<glm::vec3> near_clipping_corners;
-std::vector<glm::vec3> first_hitpoints;
-std::vector<glm::vec3> second_hitpoints;
-std::vector<glm::vec3> sample_grid;
 std::vector<glm::vec3> origin;
-std::vector<glm::vec3> dome_vertices;
-std::vector<glm::vec3> screen_points;
-std::vector<glm::vec3> texture_coords;
+
+// background recalculation, requests arriving during a calculation are served by a single rerun
+std::mutex recalculation_mutex;
+std::condition_variable recalculation_condition;
+bool recalculation_requested = false;
+bool recalculation_stopping = false;
 
 // raycast globals
 int SAMPLE_RINGS = 72;
@@ -61,6 +133,18 @@ int SAMPLE_RING_POINTS = 72;
 int DOME_RINGS = 18;
 int DOME_RING_ELEMENTS = 36;
 
+// points kept by every node of the point cloud octrees
+unsigned int POINT_NODE_CAPACITY = 4096;
+
+// coarse mesh levels keep at least this many rows and columns
+int MIN_LEVEL_DIVISIONS = 4;
+
+// hands every finished warp mesh to a live warper process
+SharedMeshPublisher mesh_publisher;
+
+// a subscriber gives up after this long without a new mesh
+int SUBSCRIBE_TIMEOUT_MS = 10000;
+
 std::map<std::string, json11::Json> model_config;
 std::map<std::string, json11::Json> application_config;
 
@@ -115,17 +199,11 @@ bool loadConfig(std::string const &file_name, std::map<std::string, json11::Json
  */
 GLuint createVertexBuffer(std::vector<GLfloat> const &vertex_data) {
 
-    // create clike array to pass it to gl
-    GLfloat arr[vertex_data.size()];
-    for (int i = 0; i < vertex_data.size(); ++i) {
-        arr[i] = vertex_data[i];
-    }
-
     // generate buffer
     GLuint vertexbuffer_id;
     glGenBuffers(1, &vertexbuffer_id);
     glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer_id);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(arr), arr, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertex_data.size() * sizeof(GLfloat), vertex_data.data(), GL_STATIC_DRAW);
 
     return vertexbuffer_id;
 }
@@ -141,20 +219,17 @@ GLuint createVertexBuffer(std::vector<GLfloat> const &vertex_data) {
  */
 GLuint createSolidColorBuffer(int size, float r, float g, float b) {
 
-    std::cout << size << std::endl;
-    GLfloat arr[size];
-    std::cout << size / 3 << std::endl;
+    std::vector<GLfloat> colors((unsigned long) size);
     for (int i = 0; i < size / 3; ++i) {
-        arr[i * 2] = r;
-        arr[i * 2 + 1] = g;
-        arr[i * 3 + 2] = b;
-        std::cout << r << " " << g << " " << b << std::endl;
+        colors[i * 3] = r;
+        colors[i * 3 + 1] = g;
+        colors[i * 3 + 2] = b;
     }
 
     GLuint colorbuffer_id;
     glGenBuffers(1, &colorbuffer_id);
     glBindBuffer(GL_ARRAY_BUFFER, colorbuffer_id);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(arr), arr, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
 
     return colorbuffer_id;
 }
@@ -223,6 +298,11 @@ int initializeGLContext(bool show_mouse, bool with_vsync) {
  */
 void cleanupGL() {
 
+    markers.release();
+    point_clouds.release();
+    frame_profiler.release();
+    stream_buffers.release();
+
     // Cleanup VBO
     for (int i = 0; i < vertex_buffer_ids.size(); ++i) {
         glDeleteBuffers(1, &vertex_buffer_ids[i]);
@@ -238,7 +318,16 @@ void cleanupGL() {
 
 }
 
-void buildModel() {
+/**
+ * build mirror, dome and projector as described by the model config
+ * @param model_config
+ * @param level 0 for the configured resolution, every level above halves the
+ *              sample grid and the dome tessellation along both directions
+ * @return
+ */
+std::shared_ptr<Model> buildModel(std::map<std::string, json11::Json> &model_config, int level) {
+
+    std::shared_ptr<Model> model = std::make_shared<Model>();
 
     glm::vec3 mirror_position = jsonArray2Vec3(model_config["mirror"]["position"]);
     glm::vec3 dome_position = jsonArray2Vec3(model_config["dome"]["position"]);
@@ -247,8 +336,8 @@ void buildModel() {
     float dome_radius = (float) model_config["dome"]["radius"].number_value();
 
     // create mirror & dome
-    mirror = new Sphere(mirror_radius, mirror_position);
-    dome = new Sphere(dome_radius, dome_position);
+    model->mirror = new Sphere(mirror_radius, mirror_position);
+    model->dome = new Sphere(dome_radius, dome_position);
 
     float fov = (float) model_config["projector"]["fov"].number_value();
     int screen_width = (int) model_config["projector"]["screen"]["w"].number_value();
@@ -263,84 +352,224 @@ void buildModel() {
     // view mat
     glm::vec3 projector_world_pos = jsonArray2Vec3(model_config["projector"]["position"]);
 
-    int grid_rings = (int) model_config["projector"]["grid"]["num_rings"].number_value();
-    int grid_ring_elements = (int) model_config["projector"]["grid"]["num_ring_elements"].number_value();
+    // radial layouts are sized in rings, all others in rows and columns
+    json11::Json const &grid = model_config["projector"]["grid"];
+    GridGenerator::Layout grid_layout = GridGenerator::POLAR;
+    if (grid["layout"].is_string() && !GridGenerator::parseLayout(grid["layout"].string_value(), &grid_layout)) {
+        std::cout << "unknown grid layout '" << grid["layout"].string_value() << "', using polar" << std::endl;
+    }
+
+    int grid_rows = (int) grid["num_rings"].number_value();
+    int grid_columns = (int) grid["num_ring_elements"].number_value();
+    if (grid_layout != GridGenerator::POLAR && grid_layout != GridGenerator::CONCENTRIC) {
+        grid_rows = (int) grid["rows"].number_value();
+        grid_columns = (int) grid["columns"].number_value();
+    }
+    int level_scale = 1 << level;
+    grid_rows = std::max(grid_rows / level_scale, MIN_LEVEL_DIVISIONS);
+    grid_columns = std::max(grid_columns / level_scale, MIN_LEVEL_DIVISIONS);
+
+    // the pixel layout follows the projector resolution
+    GridGenerator grid_generator(grid_layout, grid_rows, grid_columns);
+    if (grid_layout == GridGenerator::PIXEL) {
+        int pixel_stride = grid["pixel_stride"].is_number() ? (int) grid["pixel_stride"].number_value() : 1;
+        grid_generator = GridGenerator::pixelAligned(screen_width, screen_height, pixel_stride * level_scale);
+    }
     int dome_rings = (int) model_config["projector"]["dome"]["num_rings"].number_value();
     int dome_ring_elements = (int) model_config["projector"]["dome"]["num_ring_elements"].number_value();
+    dome_rings = std::max(dome_rings / level_scale, MIN_LEVEL_DIVISIONS);
+    dome_ring_elements = std::max(dome_ring_elements / level_scale, MIN_LEVEL_DIVISIONS);
 
     // build the dome projector
-    screen = new Screen(screen_width, screen_height);
-    frustum = new Frustum(projector_projection, projector_world_pos, true);
-    dp = new DomeProjector(frustum,
-                           screen,
-                           grid_rings,
-                           grid_ring_elements,
-                           projector_world_pos,
-                           dome_rings,
-                           dome_ring_elements);
+    Screen *screen = new Screen(screen_width, screen_height);
+    model->frustum = new Frustum(projector_projection, projector_world_pos, true);
+    model->projector = new DomeProjector(model->frustum,
+                                         screen,
+                                         grid_generator,
+                                         projector_world_pos,
+                                         dome_rings,
+                                         dome_ring_elements);
+
+    DomeProjector *dp = model->projector;
+
+    std::string mapping = model_config["projector"]["mapping"].string_value();
+    if (mapping == "barycentric") {
+        dp->set_mapping_mode(DomeProjector::BARYCENTRIC);
+    } else if (mapping == "walk") {
+        dp->set_mapping_mode(DomeProjector::WALK);
+    }
+
+    json11::Json dome_config = model_config["projector"]["dome"];
+    if (dome_config["tessellation"].string_value() == "geodesic") {
+        dp->set_dome_tessellation(DomeProjector::GEODESIC, std::max((int) dome_config["subdivisions"].number_value() - level, 1));
+    }
+
+    dp->set_ray_differentials(model_config["projector"]["ray_differentials"].bool_value());
+
+    float snap_tolerance = (float) model_config["metrics"]["tolerance"].number_value();
+    if (snap_tolerance > 0.0f) {
+        dp->set_snap_tolerance(snap_tolerance);
+    }
+
+    return model;
+}
 
+
+/**
+ * collects the indices of all hits that did not get lost on their way
+ * @param hits
+ * @return
+ */
+std::vector<unsigned int> hitIndices(ResultView<glm::vec3> const &hits) {
+    std::vector<unsigned int> result;
+    result.reserve(hits.size());
+    for (unsigned int i = 0; i < hits.size(); ++i) {
+        if (!DomeProjector::isMiss(hits[i])) {
+            result.push_back(i);
+        }
+    }
+    return result;
 }
 
 
 /**
  * run model calculations duuh
+ * @param model
  */
-void runModelCalculations() {
-    dp->calculateDomeHitpoints(mirror, dome);
+void runModelCalculations(Model *model) {
+    DomeProjector *dp = model->projector;
+    dp->calculateDomeHitpoints(model->mirror, model->dome);
     dp->calculateTransformationMesh();
+    std::cout << dp->get_metrics() << std::endl;
 
-    far_clipping_corners = frustum->_near_clipping_corners;
-    near_clipping_corners = frustum->_far_clipping_corners;
+    if (mesh_publisher.is_open()) {
+        mesh_publisher.publish(dp->get_mesh());
+    }
 
-    first_hitpoints = dp->get_first_hits();
-    second_hitpoints = dp->get_second_hits();
-    sample_grid = dp->get_sample_grid();
-    dome_vertices = dp->get_dome_vertices();
+    model->far_clipping_corners = model->frustum->_near_clipping_corners;
+    model->near_clipping_corners = model->frustum->_far_clipping_corners;
 
-    screen_points = dp->get_screen_points();
-    texture_coords = dp->get_texture_coords();
+    // the level of detail hierarchies get built here, off the render thread,
+    // everything else gets drawn straight from the projectors results
+    model->sample_grid_octree.build(dp->get_sample_grid(), POINT_NODE_CAPACITY);
+    model->first_hit_octree.build(dp->get_first_hits(), hitIndices(dp->get_first_hits()), POINT_NODE_CAPACITY);
+    model->second_hit_octree.build(dp->get_second_hits(), hitIndices(dp->get_second_hits()), POINT_NODE_CAPACITY);
 }
 
 
 /**
- * draw a vertex array
- * @param matrix_id
- * @param vertex_buffer_id
- * @param mvp
+ * asks the background worker for a recalculation
  */
-void
-drawVertexArray(GLuint matrix_id, GLuint vertex_buffer_id, glm::mat4 mvp, int num_vertices, GLuint colorbuffer_id) {
-
-    // send transformation to current shader
-    glUniformMatrix4fv(matrix_id, 1, GL_FALSE, &mvp[0][0]);
-
-    // vertex attribute buffer
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_id);
-    glVertexAttribPointer(
-            0,                  // attribute 0 must match shader layout
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void *) 0          // array buffer offset
-    );
+void requestRecalculation() {
+    std::lock_guard<std::mutex> lock(recalculation_mutex);
+    recalculation_requested = true;
+    recalculation_condition.notify_one();
+}
 
-    // color
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer_id);
-    glVertexAttribPointer(
-            1,                  // attribute 0 must match shader layout
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void *) 0          // array buffer offset
-    );
 
-    glDrawArrays(GL_TRIANGLES, 0, num_vertices); // 3 indices starting at 0 -> 1 triangle
+/**
+ * reloads the configs and recalculates the model for every request,
+ * the finished model replaces the current one in a single atomic store.
+ * Every calculation runs from the coarsest level down to the configured resolution,
+ * each level gets published as soon as it is done and seeds the search of the next.
+ * A new request drops the remaining levels.
+ * The worker only reads the configs handed to it, the globals belong to the main thread.
+ * @param worker_model_config model config the seed got built from
+ * @param publish_settings publish settings the publisher got opened with
+ * @param num_levels number of levels of every calculation
+ * @param seed model of the level above the first one to refine, may be empty
+ * @param level first level to refine, -1 to wait for a request
+ */
+void recalculationWorker(std::map<std::string, json11::Json> worker_model_config, json11::Json publish_settings,
+                         int num_levels, std::shared_ptr<Model> seed, int level) {
+
+    for (;;) {
+        bool requested;
+        {
+            std::unique_lock<std::mutex> lock(recalculation_mutex);
+            recalculation_condition.wait(lock, [level] {
+                return recalculation_requested || recalculation_stopping || level >= 0;
+            });
+            if (recalculation_stopping) {
+                return;
+            }
+            requested = recalculation_requested;
+            recalculation_requested = false;
+        }
+
+        if (!requested) {
+            std::shared_ptr<Model> model = buildModel(worker_model_config, level);
+            if (seed) {
+                model->projector->seedMapping(*seed->projector);
+            }
+            runModelCalculations(model.get());
+            std::atomic_store(&current_model, model);
+            seed = model;
+            --level;
+            continue;
+        }
+
+        std::map<std::string, json11::Json> new_application_config;
+        std::map<std::string, json11::Json> new_model_config;
+        if (!loadConfig("../configs/application.json", new_application_config) ||
+            !loadConfig("../configs/model.json", new_model_config)) {
+            std::cout << "failed to reload config" << std::endl;
+            continue;
+        }
+
+        // only this thread publishes meshes once it runs
+        json11::Json new_publish_settings = new_application_config["publish"];
+        if (new_publish_settings != publish_settings) {
+            publish_settings = new_publish_settings;
+            mesh_publisher.close();
+            if (publish_settings["enabled"].bool_value()) {
+                mesh_publisher.open(publish_settings["name"].string_value(),
+                                    publish_settings["slots"].int_value(),
+                                    (unsigned long) publish_settings["max_vertices"].number_value(),
+                                    (unsigned long) publish_settings["max_indices"].number_value());
+            }
+        }
+
+        worker_model_config = new_model_config;
+        num_levels = std::max(new_application_config["options"]["progressive_levels"].int_value(), 1);
+        level = num_levels - 1;
+        seed.reset();
+    }
+}
+
+
+/**
+ * streams the drawables of a model into the marker sets and point clouds,
+ * the point clouds keep using the octrees of the model
+ * @param model
+ */
+void uploadMarkers(Model const &model) {
+    std::vector<glm::vec3> clipping_corners(model.far_clipping_corners);
+    clipping_corners.insert(clipping_corners.end(),
+                            model.near_clipping_corners.begin(), model.near_clipping_corners.end());
+
+    ResultView<glm::vec3> dome_vertices = model.projector->get_dome_vertices();
+    ResultView<glm::vec3> screen_points = model.projector->get_screen_points();
+
+    // every set lands in the next region of the stream buffers
+    std::vector<ResultView<glm::vec3>> point_sets = {
+            clipping_corners, origin, dome_vertices, screen_points,
+            model.sample_grid_octree.get_points(), model.first_hit_octree.get_points(),
+            model.second_hit_octree.get_points()};
+    size_t num_bytes = 0;
+    for (auto const &points : point_sets) {
+        num_bytes += BufferManager::alignedSize(points.size() * sizeof(glm::vec3));
+    }
+    stream_buffers.beginUpload(num_bytes);
 
-    glDisableVertexAttribArray(0);
+    markers.upload(ORIGIN_MARKERS, origin);
+    markers.upload(CLIPPING_CORNER_MARKERS, clipping_corners);
+    markers.upload(DOME_VERTEX_MARKERS, dome_vertices);
+    markers.upload(SCREEN_POINT_MARKERS, screen_points);
+
+    point_clouds.upload(SAMPLE_GRID_POINTS, &model.sample_grid_octree);
+    point_clouds.upload(FIRST_HIT_POINTS, &model.first_hit_octree);
+    point_clouds.upload(SECOND_HIT_POINTS, &model.second_hit_octree);
 }
 
 
@@ -355,14 +584,15 @@ drawVertexArray(GLuint matrix_id, GLuint vertex_buffer_id, glm::mat4 mvp, int nu
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
 
     if (key == GLFW_KEY_S && action == GLFW_RELEASE) {
-        dp->saveTransformations();
+        std::atomic_load(&current_model)->projector->saveTransformations();
+    } else if (key == GLFW_KEY_E && action == GLFW_RELEASE) {
+        std::atomic_load(&current_model)->projector->exportGeometry("../../glwarp/");
     } else if (key == GLFW_KEY_R && action == GLFW_RELEASE) {
-        if (loadConfig("../configs/model.json", model_config)) {
-            buildModel();
-            runModelCalculations();
-        } else {
-            std::cout << "failed to reload config" << std::endl;
-        }
+        requestRecalculation();
+    } else if (key >= GLFW_KEY_1 && key <= GLFW_KEY_3 && action == GLFW_RELEASE) {
+        // toggle sample grid, first and second hits
+        int cloud_idx = SAMPLE_GRID_POINTS + key - GLFW_KEY_1;
+        point_clouds.set_visible(cloud_idx, !point_clouds.is_visible(cloud_idx));
     }
 }
 
@@ -370,107 +600,74 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 /**
  * render
  * @param mvp
+ * @param point_budget maximum number of point cloud points per frame
+ * @param point_size
  */
-void render(glm::mat4 mvp) {
-
-    // get uniform locations
-    GLint matrix_id = glGetUniformLocation(shader_program_ids[0], "MVP");
+void render(glm::mat4 mvp, unsigned long point_budget, float point_size) {
 
     glfwSetKeyCallback(window, key_callback);
 
+    // model whose drawables sit in the marker buffers, also keeps the octrees of the point clouds alive
+    std::shared_ptr<Model> uploaded_model;
+    unsigned long uploaded_generation = 0;
+    unsigned long num_points = 0;
+
+    int input_phase = frame_profiler.addPhase("input");
+    int upload_phase = frame_profiler.addPhase("upload");
+    int marker_phase = frame_profiler.addPhase("markers");
+    int point_cloud_phase = frame_profiler.addPhase("point_clouds");
+    int swap_phase = frame_profiler.addPhase("swap");
+
     bool running = true;
     double last_time = glfwGetTime();
-    int num_frames = 0;
     while (running && glfwWindowShouldClose(window) == 0) {
 
+        frame_profiler.beginFrame();
+
         double current_time = glfwGetTime();
-        ++num_frames;
         if (current_time - last_time >= 1.0) {
             // this works better than expected, neat
             std::cout << "\r";
-            std::cout << "ms/frame: " << (1000.0 / double(num_frames));
-            num_frames = 0;
+            std::cout << frame_profiler.summary() << "points: " << num_points << "    " << std::flush;
             last_time += 1.0;
         }
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // use shader
-        glUseProgram(shader_program_ids[0]);
+        // hold on to the current model for the whole frame, a recalculated one shows up next frame
+        std::shared_ptr<Model> model = std::atomic_load(&current_model);
 
         /*
          * keyboard input
          */
-        glm::mat4 current_mvp;
         if (glfwGetKey(window, GLFW_KEY_A)) {
             mvp = glm::rotate(mvp, glm::radians(1.0f), glm::vec3(0, 1, 0));
         } else if (glfwGetKey(window, GLFW_KEY_D)) {
             mvp = glm::rotate(mvp, glm::radians(-1.0f), glm::vec3(0, 1, 0));
         }
+        frame_profiler.mark(input_phase);
 
-        /*
-         * for shape in scene
-         *   do render
-         */
-
-
-//        for (auto element : sample_grid) {
-//            current_mvp = glm::translate(mvp, element);
-//            current_mvp = glm::scale(current_mvp, glm::vec3(0.01, 0.01, 0.01));
-//            drawVertexArray(matrix_id, vertex_array_ids[0], current_mvp, 2 * 3, color_map["blue"]);
-//        }
-
-//        for (auto element : first_hitpoints) {
-//            current_mvp = glm::translate(mvp, element);
-//            current_mvp = glm::scale(current_mvp, glm::vec3(0.01, 0.01, 0.01));
-//            drawVertexArray(matrix_id, vertex_array_ids[0], current_mvp, 2 * 3, color_map["green"]);
-//        }
-
-//        for (auto element : second_hitpoints) {
-//            current_mvp = glm::translate(mvp, element);
-//            current_mvp = glm::scale(current_mvp, glm::vec3(0.01, 0.01, 0.01));
-//            drawVertexArray(matrix_id, vertex_array_ids[0], current_mvp, 2 * 3, color_map["red"]);
-//        }
-
-        for (auto element: far_clipping_corners) {
-            current_mvp = glm::translate(mvp, element);
-            current_mvp = glm::scale(current_mvp, glm::vec3(0.01, 0.01, 0.01));
-            drawVertexArray(matrix_id, vertex_array_ids[0], current_mvp, 2 * 3, color_map["yellow"]);
-        }
-
-        for (auto element: near_clipping_corners) {
-            current_mvp = glm::translate(mvp, element);
-            current_mvp = glm::scale(current_mvp, glm::vec3(0.01, 0.01, 0.01));
-            drawVertexArray(matrix_id, vertex_array_ids[0], current_mvp, 2 * 3, color_map["yellow"]);
-        }
-
-        for (auto element: origin) {
-            current_mvp = glm::translate(mvp, element);
-            current_mvp = glm::scale(current_mvp, glm::vec3(0.01, 0.01, 0.01));
-            drawVertexArray(matrix_id, vertex_array_ids[0], current_mvp, 2 * 3, color_map["yellow"]);
+        // points only get uploaded when the model or its results changed
+        if (model != uploaded_model || model->projector->get_generation() != uploaded_generation) {
+            uploadMarkers(*model);
+            uploaded_model = model;
+            uploaded_generation = model->projector->get_generation();
         }
+        frame_profiler.mark(upload_phase);
 
-        for (auto element: dome_vertices) {
-            current_mvp = glm::translate(mvp, element);
-            current_mvp = glm::scale(current_mvp, glm::vec3(0.01, 0.01, 0.01));
-            drawVertexArray(matrix_id, vertex_array_ids[0], current_mvp, 2 * 3, color_map["grey"]);
-        }
+        markers.draw(mvp, 0.01f);
+        frame_profiler.mark(marker_phase);
 
-        for (auto element: screen_points) {
-            current_mvp = glm::translate(mvp, element);
-            current_mvp = glm::scale(current_mvp, glm::vec3(0.01, 0.01, 0.01));
-            drawVertexArray(matrix_id, vertex_array_ids[0], current_mvp, 2 * 3, color_map["grey"]);
-        }
+        num_points = point_clouds.draw(mvp, point_budget, point_size);
+        frame_profiler.mark(point_cloud_phase);
 
-//        for (auto element : dp->corresponding_hitpoints) {
-//            current_mvp = glm::translate(mvp, element);
-//            current_mvp = glm::scale(current_mvp, glm::vec3(0.01, 0.01, 0.01));
-//            drawVertexArray(matrix_id, vertex_array_ids[0], current_mvp, 2 * 3, color_map["green"]);
-//        }
+        // the gpu timer covers everything submitted up to the swap
+        frame_profiler.endFrame();
 
         // Swap buffers
         glfwSwapBuffers(window);
         glfwPollEvents();
+        frame_profiler.mark(swap_phase);
 
         // check for keyboard input
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS ||
@@ -481,56 +678,307 @@ void render(glm::mat4 mvp) {
     }
 }
 
-void setupBuffers() {
-
-    GLuint colorbuffer_blue;
-    glGenBuffers(1, &colorbuffer_blue);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer_blue);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data::quat_blue), vertex_buffer_data::quat_blue, GL_STATIC_DRAW);
-    color_map["blue"] = colorbuffer_blue;
-
-    GLuint colorbuffer_green;
-    glGenBuffers(1, &colorbuffer_green);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer_green);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data::quat_green), vertex_buffer_data::quat_green,
-                 GL_STATIC_DRAW);
-    color_map["green"] = colorbuffer_green;
-
-    GLuint colorbuffer_red;
-    glGenBuffers(1, &colorbuffer_red);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer_red);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data::quat_red), vertex_buffer_data::quat_red, GL_STATIC_DRAW);
-    color_map["red"] = colorbuffer_red;
-
-    GLuint colorbuffer_yellow;
-    glGenBuffers(1, &colorbuffer_yellow);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer_yellow);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data::quat_yellow), vertex_buffer_data::quat_yellow,
-                 GL_STATIC_DRAW);
-    color_map["yellow"] = colorbuffer_yellow;
-
-    GLuint colorbuffer_white;
-    glGenBuffers(1, &colorbuffer_white);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer_white);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data::quat_white), vertex_buffer_data::quat_white,
-                 GL_STATIC_DRAW);
-    color_map["white"] = colorbuffer_white;
-
-    GLuint colorbuffer_grey;
-    glGenBuffers(1, &colorbuffer_grey);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer_grey);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data::quat_grey), vertex_buffer_data::quat_grey,
-                 GL_STATIC_DRAW);
-    color_map["grey"] = colorbuffer_grey;
+/**
+ * stops the calibration service on SIGINT and SIGTERM
+ */
+CalibrationService *calibration_service = nullptr;
+
+void stopService(int signal) {
+    if (calibration_service != nullptr) {
+        calibration_service->stop();
+    }
+}
+
+
+/**
+ * serves calibration requests on a unix domain socket instead of opening a window
+ * @param socket_path
+ * @return
+ */
+int runService(std::string const &socket_path) {
+
+    std::shared_ptr<Model> model = std::atomic_load(&current_model);
+    CalibrationService service(model->projector, model->mirror, model->dome, &mesh_publisher);
+    if (!service.open(socket_path)) {
+        return 1;
+    }
+
+    calibration_service = &service;
+    std::signal(SIGINT, stopService);
+    std::signal(SIGTERM, stopService);
+    service.run();
+    calibration_service = nullptr;
+
+    return 0;
+}
+
+
+/**
+ * warps a source image with the mesh of the current model into a projector frame
+ * @param source_path ppm
+ * @param target_path ppm
+ * @return
+ */
+int runWarp(std::string const &source_path, std::string const &target_path) {
+
+    Image source;
+    if (!Image::readPpm(source_path, &source)) {
+        return 1;
+    }
+
+    std::shared_ptr<Model> model = std::atomic_load(&current_model);
+    Screen const &screen = model->projector->get_screen();
+
+    WarpEngine warp_engine;
+    warp_engine.setMesh(model->projector->get_mesh(), screen.width, screen.height);
+    warp_engine.setSourceSize(source.width, source.height);
+
+    Image target;
+    auto start = std::chrono::steady_clock::now();
+    if (!warp_engine.warp(source, &target)) {
+        return 1;
+    }
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "warped " << screen.width << "x" << screen.height << " in " << elapsed_ms << " ms" << std::endl;
+
+    return target.writePpm(target_path) ? 0 : 1;
+}
+
+
+/**
+ * warps a y4m or raw rgb24 frame sequence, the output uses the format of the input
+ * @param input_path file or - for stdin
+ * @param output_path file or - for stdout
+ * @param raw_size WIDTHxHEIGHT of raw input, empty for y4m
+ * @return
+ */
+int runVideo(std::string const &input_path, std::string const &output_path, std::string const &raw_size) {
+
+    video::Reader reader;
+    int raw_width = 0;
+    int raw_height = 0;
+    if (raw_size.empty()) {
+        if (!reader.openY4m(input_path)) {
+            return 1;
+        }
+    } else if (sscanf(raw_size.c_str(), "%dx%d", &raw_width, &raw_height) != 2 || raw_width < 2 || raw_height < 2) {
+        std::cout << "raw frame size '" << raw_size << "' is not WIDTHxHEIGHT" << std::endl;
+        return 1;
+    } else if (!reader.openRaw(input_path, raw_width, raw_height)) {
+        return 1;
+    }
+
+    std::shared_ptr<Model> model = std::atomic_load(&current_model);
+    Screen const &screen = model->projector->get_screen();
+
+    WarpEngine warp_engine;
+    warp_engine.setMesh(model->projector->get_mesh(), screen.width, screen.height);
+    warp_engine.setSourceSize(reader.get_width(), reader.get_height());
+
+    video::Writer writer;
+    if (!writer.open(output_path, reader.get_format(), screen.width, screen.height, reader.get_frame_rate())) {
+        return 1;
+    }
+
+    VideoPipeline pipeline(&warp_engine, (int) parallel::numThreads());
+    bool success = pipeline.run(&reader, &writer);
+    std::cout << "\nwarped " << pipeline.get_num_frames() << " frames at " << pipeline.get_fps() << " fps" << std::endl;
+
+    return success ? 0 : 1;
+}
+
+
+/**
+ * estimates the light scattered inside the dome until it converges
+ * @param output_path json written with the irradiance of every dome vertex, empty for the configured path
+ * @return
+ */
+int runStrayLight(std::string const &output_path) {
+
+    std::shared_ptr<Model> model = std::atomic_load(&current_model);
+    json11::Json config = model_config["stray_light"];
+
+    InterReflection inter_reflection;
+    inter_reflection.setup(*model->dome,
+                           model->projector->get_dome_vertices(),
+                           model->projector->get_dome_indices(),
+                           model->projector->get_second_hits(),
+                           (float) config["albedo"].number_value(),
+                           config["max_bounces"].int_value());
+
+    bool converged = inter_reflection.estimate((float) config["tolerance"].number_value(),
+                                               config["max_passes"].int_value(),
+                                               config["max_seconds"].number_value());
+    if (!converged) {
+        std::cout << "inter-reflection estimate stopped at " << inter_reflection.get_error() * 100.0f
+                  << "% error" << std::endl;
+    }
 
+    std::string path = output_path.empty() ? config["output"].string_value() : output_path;
+    return inter_reflection.writeJson(path) ? 0 : 1;
+}
+
+
+/**
+ * maps the dome of the configured model by walking and by the full search and compares both,
+ * every dome vertex needs to end up at the same distance to its hit
+ * @return
+ */
+int runMappingCheck() {
+
+    std::shared_ptr<Model> nearest_model = buildModel(model_config, 0);
+    std::shared_ptr<Model> walk_model = buildModel(model_config, 0);
+    nearest_model->projector->set_mapping_mode(DomeProjector::NEAREST);
+    walk_model->projector->set_mapping_mode(DomeProjector::WALK);
+
+    for (Model *model : {nearest_model.get(), walk_model.get()}) {
+        model->projector->calculateDomeHitpoints(model->mirror, model->dome);
+        model->projector->calculateTransformationMesh();
+    }
+
+    DomeProjector const &nearest = *nearest_model->projector;
+    DomeProjector const &walk = *walk_model->projector;
+    if (nearest.get_vertex_samples().size() != walk.get_vertex_samples().size()) {
+        std::cout << "mapping check needs a grid searched per dome vertex, the pixel layout maps directly" << std::endl;
+        return 1;
+    }
+
+    // equally distant hits may both be the nearest one, so only the distances have to agree
+    ResultView<glm::vec3> hits = nearest.get_second_hits();
+    ResultView<glm::vec3> vertices = nearest.get_dome_vertices();
+    unsigned long num_mismatches = 0;
+    float max_difference = 0.0f;
+    for (unsigned long i = 0; i < vertices.size(); ++i) {
+        int nearest_idx = nearest.get_vertex_samples()[i];
+        int walk_idx = walk.get_vertex_samples()[i];
+        if (nearest_idx < 0 || walk_idx < 0) {
+            num_mismatches += nearest_idx == walk_idx ? 0 : 1;
+            continue;
+        }
+        float difference = glm::length(hits[walk_idx] - vertices[i]) - glm::length(hits[nearest_idx] - vertices[i]);
+        max_difference = std::max(max_difference, std::abs(difference));
+        num_mismatches += std::abs(difference) > 1e-6f ? 1 : 0;
+    }
+
+    std::cout << "walk against full search: " << num_mismatches << " of " << vertices.size()
+              << " dome vertices differ, max distance difference " << max_difference << std::endl;
+    return num_mismatches == 0 ? 0 : 1;
+}
+
+
+/**
+ * consumes the meshes of a running publisher in place and checks every one of them,
+ * the way a warper process would before using a mesh
+ * @param name shared memory name
+ * @param num_meshes number of meshes to receive
+ * @return
+ */
+int runSubscriber(std::string const &name, int num_meshes) {
+
+    SharedMeshSubscriber subscriber;
+    if (!subscriber.open(name)) {
+        std::cout << "no warp meshes published as '" << name << "'" << std::endl;
+        return 1;
+    }
+
+    uint32_t notify = 0;
+    uint64_t last_frame = 0;
+    int num_received = 0;
+    unsigned long num_skipped = 0;
+    unsigned long num_retries = 0;
+    unsigned long num_broken = 0;
+
+    while (num_received < num_meshes) {
+
+        // a publisher changing its settings replaces the region under the same name
+        if (subscriber.is_closed()) {
+            subscriber.close();
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SUBSCRIBE_TIMEOUT_MS);
+            while (!subscriber.open(name) && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            if (!subscriber.is_open()) {
+                std::cout << "warp meshes of '" << name << "' got closed" << std::endl;
+                break;
+            }
+            std::cout << "following the new warp mesh region of '" << name << "'" << std::endl;
+            notify = 0;
+            last_frame = 0;
+            continue;
+        }
+
+        SharedMeshView view;
+        uint32_t view_notify = notify;
+        bool acquired = subscriber.acquire(&view, &view_notify);
+
+        // nothing published yet or the newest slot stays half written, only a new mesh helps
+        if (!acquired) {
+            notify = view_notify;
+        }
+        if (!acquired || view.frame == last_frame) {
+            if (!subscriber.wait(notify, SUBSCRIBE_TIMEOUT_MS)) {
+                std::cout << "no new warp mesh within " << SUBSCRIBE_TIMEOUT_MS << " ms" << std::endl;
+                break;
+            }
+            continue;
+        }
+
+        // use the mesh where it lies, every index has to name a vertex
+        unsigned int max_index = 0;
+        for (uint32_t i = 0; i < view.num_indices; ++i) {
+            unsigned int index = view.index_bytes == sizeof(unsigned short)
+                                 ? ((unsigned short const *) view.indices)[i]
+                                 : ((unsigned int const *) view.indices)[i];
+            max_index = std::max(max_index, index);
+        }
+        bool complete = view.num_indices % 3 == 0 && (view.num_indices == 0 || max_index < view.num_vertices);
+
+        // the publisher reused the slot meanwhile, so the check above may have seen a torn mesh
+        if (!subscriber.validate(view)) {
+            ++num_retries;
+            continue;
+        }
+
+        num_skipped += last_frame > 0 ? view.frame - last_frame - 1 : 0;
+        num_broken += complete ? 0 : 1;
+        last_frame = view.frame;
+        notify = view_notify;
+        ++num_received;
+
+        std::cout << "warp mesh " << view.frame << ": " << view.num_vertices << " vertices, "
+                  << view.num_indices / 3 << " triangles" << (complete ? "" : ", broken indices") << std::endl;
+    }
+
+    std::cout << num_received << " warp meshes received, " << num_skipped << " skipped, "
+              << num_retries << " retried, " << num_broken << " broken" << std::endl;
+    return num_received == num_meshes && num_broken == 0 ? 0 : 1;
 }
 
 
 /**
  * main function
+ * @param argc
+ * @param argv --service [socket path] runs the calibration service,
+ *             --warp <source.ppm> <target.ppm> warps a single image on the cpu,
+ *             --video <input> <output> [WIDTHxHEIGHT] warps a y4m or, given its size, raw rgb24 sequence,
+ *             --stray-light [output.json] estimates the light scattered inside the dome,
+ *             --check-mapping compares the walk with the full nearest hit search,
+ *             --subscribe [name] [count] checks the warp meshes published by another instance
  * @return
  */
-int main() {
+int main(int argc, char **argv) {
+
+    bool service_mode = argc > 1 && std::string(argv[1]) == "--service";
+    bool warp_mode = argc > 3 && std::string(argv[1]) == "--warp";
+    bool video_mode = argc > 3 && std::string(argv[1]) == "--video";
+    bool stray_light_mode = argc > 1 && std::string(argv[1]) == "--stray-light";
+    bool check_mapping_mode = argc > 1 && std::string(argv[1]) == "--check-mapping";
+    bool subscribe_mode = argc > 1 && std::string(argv[1]) == "--subscribe";
+
+    // frames written to stdout must not mix with the log
+    if (video_mode && std::string(argv[3]) == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
 
 
     ProjectorFrustum f(16.0f / 9.0f, 90, 1.0f, 2.0f);
@@ -559,12 +1007,68 @@ int main() {
         return 0;
     }
 
-    buildModel();
-    runModelCalculations();
+    // runs before the publisher opens, the check must not hand out its meshes
+    if (check_mapping_mode) {
+        return runMappingCheck();
+    }
+
+    // opening the publisher would replace the region this instance is meant to read
+    if (subscribe_mode) {
+        std::string name = argc > 2 ? argv[2] : application_config["publish"]["name"].string_value();
+        return runSubscriber(name, argc > 3 ? std::atoi(argv[3]) : 1);
+    }
+
+    json11::Json publish_config = application_config["publish"];
+    if (publish_config["enabled"].bool_value()) {
+        mesh_publisher.open(publish_config["name"].string_value(),
+                            publish_config["slots"].int_value(),
+                            (unsigned long) publish_config["max_vertices"].number_value(),
+                            (unsigned long) publish_config["max_indices"].number_value());
+    }
+
+    // the window shows a coarse level first and refines it in the background,
+    // all other modes need the full resolution right away
+    bool window_mode = !service_mode && !warp_mode && !video_mode && !stray_light_mode;
+    int num_levels = std::max(application_config["options"]["progressive_levels"].int_value(), 1);
+    int preview_level = window_mode ? num_levels - 1 : 0;
+
+    // calculate the first model while the window gets created and the shaders compile,
+    // nothing else touches the model config or the publisher until it is done
+    std::future<std::shared_ptr<Model>> initial_model = std::async(std::launch::async, [preview_level] {
+        std::shared_ptr<Model> model = buildModel(model_config, preview_level);
+        runModelCalculations(model.get());
+        return model;
+    });
+
+    if (warp_mode) {
+        std::atomic_store(&current_model, initial_model.get());
+        return runWarp(argv[2], argv[3]);
+    }
+
+    if (video_mode) {
+        std::atomic_store(&current_model, initial_model.get());
+        return runVideo(argv[2], argv[3], argc > 4 ? argv[4] : "");
+    }
+
+    if (stray_light_mode) {
+        std::atomic_store(&current_model, initial_model.get());
+        return runStrayLight(argc > 2 ? argv[2] : "");
+    }
+
+    if (service_mode) {
+        std::atomic_store(&current_model, initial_model.get());
+        std::string socket_path = application_config["service"]["socket"].string_value();
+        if (argc > 2) {
+            socket_path = argv[2];
+        }
+        return runService(socket_path);
+    }
 
     bool mouse_enabled = application_config["options"]["mouse"].bool_value();
     bool vsync_enabled = application_config["options"]["vsync"].bool_value();
     initializeGLContext(mouse_enabled, vsync_enabled);
+    frame_profiler.initialize();
+    SetProgramCacheDirectory(application_config["options"]["program_cache"].string_value());
 
     // generate vertex array
     GLuint vertex_array_id;
@@ -574,15 +1078,24 @@ int main() {
 
     // create buffers
     vertex_buffer_ids.push_back(createVertexBuffer(vertex_buffer_data::quad));
-    setupBuffers();
 
-    // load shaders
-    GLuint program_id = LoadShaders("../shaders/simple.vert", "../shaders/simple.frag");
-    shader_program_ids.push_back(program_id);
+    // stream buffers sized for the points of the current model config, they grow if needed
+    double stream_buffer_mb = application_config["options"]["stream_buffer_mb"].number_value();
+    stream_buffers.initialize((size_t) (stream_buffer_mb * 1024.0 * 1024.0));
+
+    // marker sets in the order of MarkerSet
+    markers.initialize(&stream_buffers, vertex_buffer_ids[0], (int) vertex_buffer_data::quad.size() / 3,
+                       "../shaders/instanced.vert", "../shaders/instanced.frag");
+    markers.addSet(glm::vec3(1.0f, 1.0f, 0.0f));
+    markers.addSet(glm::vec3(1.0f, 1.0f, 0.0f));
+    markers.addSet(glm::vec3(0.5f, 0.5f, 0.5f));
+    markers.addSet(glm::vec3(0.5f, 0.5f, 0.5f));
 
-    // build model view projector_projection matrix
-    // Get a handle for our "MVP" uniform
-    GLint matrix_id = glGetUniformLocation(program_id, "MVP");
+    // point clouds in the order of PointCloudSet
+    point_clouds.initialize(&stream_buffers, "../shaders/pointcloud.vert", "../shaders/pointcloud.frag");
+    point_clouds.addCloud(glm::vec3(0.0f, 0.0f, 1.0f));
+    point_clouds.addCloud(glm::vec3(0.0f, 1.0f, 0.0f));
+    point_clouds.addCloud(glm::vec3(1.0f, 0.0f, 0.0f));
 
     origin.emplace_back((0, 0, 0));
 
@@ -610,18 +1123,50 @@ int main() {
     // MVP
     glm::mat4 mvp = camera_projection * camera_view * model;
 
+    // the first frame needs the model
+    std::shared_ptr<Model> preview_model = initial_model.get();
+    std::atomic_store(&current_model, preview_model);
+
+    // refine the preview and recalculate in the background whenever a config changes,
+    // the worker gets its own copies of the configs
+    std::thread recalculation_thread(recalculationWorker, model_config, application_config["publish"],
+                                     num_levels, preview_model, preview_level - 1);
+    ConfigWatcher config_watcher({"../configs/model.json", "../configs/application.json"},
+                                 application_config["options"]["debounce_ms"].int_value(),
+                                 [](std::vector<std::string> const &changed) {
+                                     std::cout << "\n" << changed.front() << " changed, recalculating" << std::endl;
+                                     requestRecalculation();
+                                 });
+    if (application_config["options"]["watch_configs"].bool_value()) {
+        config_watcher.start();
+    }
+
     // -----------------------
     // DRAW
-    render(mvp);
+    unsigned long point_budget = (unsigned long) application_config["options"]["point_budget"].number_value();
+    float point_size = (float) application_config["options"]["point_size"].number_value();
+    render(mvp, point_budget, point_size);
     // -----------------------
 
+    config_watcher.stop();
+    {
+        std::lock_guard<std::mutex> lock(recalculation_mutex);
+        recalculation_stopping = true;
+        recalculation_condition.notify_one();
+    }
+    recalculation_thread.join();
+
+    std::string profile_output = application_config["options"]["profile_output"].string_value();
+    if (!profile_output.empty()) {
+        std::cout << std::endl << frame_profiler.summary() << std::endl;
+        frame_profiler.writeJson(profile_output);
+    }
+
     cleanupGL();
     glfwTerminate();
 
     // cleanup
-    delete dp;
-    delete mirror;
-    delete dome;
+    std::atomic_store(&current_model, std::shared_ptr<Model>());
 
 }
 
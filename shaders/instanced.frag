@@ -0,0 +1,14 @@
+#version 330 core
+
+// Ouput data
+out vec4 color;
+
+// color of the whole set
+uniform vec3 marker_color;
+
+/**
+ * main
+ */
+void main() {
+    color = vec4(marker_color, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+// marker shape, the same for all instances
+layout(location = 0) in vec3 vertex_pos_modelspace;
+
+// position of the current instance
+layout(location = 1) in vec3 instance_position;
+
+// Values that stay constant for the whole set.
+uniform mat4 MVP;
+uniform float marker_size;
+
+// main
+void main(){
+
+	// same as translating to the instance and scaling the marker afterwards
+	gl_Position = MVP * vec4(instance_position + marker_size * vertex_pos_modelspace, 1);
+
+}
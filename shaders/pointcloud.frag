@@ -0,0 +1,14 @@
+#version 330 core
+
+// Ouput data
+out vec4 color;
+
+// color of the whole cloud
+uniform vec3 point_color;
+
+/**
+ * main
+ */
+void main() {
+    color = vec4(point_color, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+// point position, in octree order
+layout(location = 0) in vec3 vertex_pos_modelspace;
+
+// Values that stay constant for the whole cloud.
+uniform mat4 MVP;
+uniform float point_size;
+
+// main
+void main(){
+
+	gl_Position = MVP * vec4(vertex_pos_modelspace, 1);
+	gl_PointSize = point_size;
+
+}
@@ -0,0 +1,150 @@
+#include <cstring>
+#include <iostream>
+
+#include "BufferManager.hpp"
+
+// triple buffering
+#define NUM_REGIONS 3
+
+// start of every write within a region
+#define WRITE_ALIGNMENT 16
+
+// a single wait on a fence, repeated until it is signaled
+#define FENCE_TIMEOUT_NS 1000000000ull
+
+/**
+ * c'tor
+ */
+BufferManager::BufferManager()
+        : _buffer_id(0)
+        , _mapped(nullptr)
+        , _persistent(false)
+        , _region_size(0)
+        , _region_idx(0)
+        , _region_offset(0)
+        , _fences(NUM_REGIONS, nullptr) {}
+
+
+bool BufferManager::initialize(size_t region_size) {
+    this->_persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    if (!this->_persistent) {
+        std::cout << "immutable buffer storage not supported, falling back to glBufferSubData" << std::endl;
+    }
+    return this->allocate(alignedSize(region_size));
+}
+
+
+bool BufferManager::allocate(size_t region_size) {
+
+    // nothing may read from the old buffer anymore
+    if (this->_buffer_id != 0) {
+        glFinish();
+        this->release();
+    }
+
+    this->_region_size = region_size;
+    this->_region_idx = 0;
+    this->_region_offset = 0;
+
+    GLsizeiptr buffer_size = (GLsizeiptr) (region_size * NUM_REGIONS);
+    glGenBuffers(1, &this->_buffer_id);
+    glBindBuffer(GL_ARRAY_BUFFER, this->_buffer_id);
+
+    if (this->_persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, buffer_size, nullptr, flags);
+        this->_mapped = (char *) glMapBufferRange(GL_ARRAY_BUFFER, 0, buffer_size, flags);
+        if (this->_mapped == nullptr) {
+            std::cout << "failed to map the stream buffer" << std::endl;
+            return false;
+        }
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, buffer_size, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    return true;
+}
+
+
+void BufferManager::beginUpload(size_t num_bytes) {
+
+    // retire the region of the previous upload, the draws reading it are all submitted
+    GLsync &current_fence = this->_fences[this->_region_idx];
+    if (current_fence != nullptr) {
+        glDeleteSync(current_fence);
+    }
+    current_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    if (num_bytes > this->_region_size) {
+        this->allocate(num_bytes + num_bytes / 2);
+    } else {
+        this->_region_idx = (this->_region_idx + 1) % NUM_REGIONS;
+        this->_region_offset = 0;
+    }
+
+    // usually signaled long ago, the region was last drawn two uploads back
+    GLsync &next_fence = this->_fences[this->_region_idx];
+    if (next_fence != nullptr) {
+        GLenum result = glClientWaitSync(next_fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(next_fence, 0, FENCE_TIMEOUT_NS);
+        }
+        glDeleteSync(next_fence);
+        next_fence = nullptr;
+    }
+}
+
+
+GLintptr BufferManager::write(void const *data, size_t num_bytes) {
+
+    if (this->_region_offset + num_bytes > this->_region_size) {
+        std::cout << "stream buffer region overflow, " << num_bytes << " bytes dropped" << std::endl;
+        return (GLintptr) (this->_region_idx * this->_region_size);
+    }
+
+    size_t offset = this->_region_idx * this->_region_size + this->_region_offset;
+    if (this->_persistent) {
+        std::memcpy(this->_mapped + offset, data, num_bytes);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, this->_buffer_id);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) offset, (GLsizeiptr) num_bytes, data);
+    }
+
+    this->_region_offset += alignedSize(num_bytes);
+    return (GLintptr) offset;
+}
+
+
+size_t BufferManager::alignedSize(size_t num_bytes) {
+    return (num_bytes + WRITE_ALIGNMENT - 1) / WRITE_ALIGNMENT * WRITE_ALIGNMENT;
+}
+
+
+GLuint BufferManager::get_buffer_id() const {
+    return this->_buffer_id;
+}
+
+
+bool BufferManager::is_persistent() const {
+    return this->_persistent;
+}
+
+
+void BufferManager::release() {
+    for (auto &fence : this->_fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    if (this->_buffer_id != 0) {
+        if (this->_mapped != nullptr) {
+            glBindBuffer(GL_ARRAY_BUFFER, this->_buffer_id);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            this->_mapped = nullptr;
+        }
+        glDeleteBuffers(1, &this->_buffer_id);
+        this->_buffer_id = 0;
+    }
+}
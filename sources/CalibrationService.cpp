@@ -0,0 +1,433 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "CalibrationService.hpp"
+
+// clipping planes of the projector frustum, as used when the model gets built
+#define PROJECTOR_NEAR 0.1f
+#define PROJECTOR_FAR 10.0f
+
+// clients sending longer lines get disconnected
+#define MAX_REQUEST_BYTES (1 << 20)
+
+// poll timeout, bounds the time until a stop request is noticed
+#define POLL_TIMEOUT_MS 250
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * Reads a vec3 given as json array
+ * @param value
+ * @param vec
+ * @return false if the value is no array of three numbers
+ */
+static bool readVec3(json11::Json const &value, glm::vec3 *vec) {
+    json11::Json::array const &items = value.array_items();
+    if (items.size() != 3 || !items[0].is_number() || !items[1].is_number() || !items[2].is_number()) {
+        return false;
+    }
+    *vec = glm::vec3(items[0].number_value(), items[1].number_value(), items[2].number_value());
+    return true;
+}
+
+static void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+/**
+ * c'tor
+ * @param projector
+ * @param mirror
+ * @param dome
+ * @param publisher
+ */
+CalibrationService::CalibrationService(DomeProjector *projector, Sphere *mirror, Sphere *dome,
+                                       SharedMeshPublisher *publisher)
+        : _projector(projector)
+        , _mirror(mirror)
+        , _dome(dome)
+        , _publisher(publisher)
+        , _listen_fd(-1)
+        , _running(false) {}
+
+
+CalibrationService::~CalibrationService() {
+    while (!this->_clients.empty()) {
+        this->closeClient(this->_clients.size() - 1);
+    }
+    if (this->_listen_fd >= 0) {
+        ::close(this->_listen_fd);
+        unlink(this->_socket_path.c_str());
+    }
+}
+
+
+bool CalibrationService::open(std::string const &socket_path) {
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+        std::cout << "invalid service socket path '" << socket_path << "'" << std::endl;
+        return false;
+    }
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cout << "failed to create service socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // a previous run may have left its socket file behind
+    unlink(socket_path.c_str());
+    if (bind(fd, (sockaddr *) &address, sizeof(address)) != 0 || listen(fd, 8) != 0) {
+        std::cout << "failed to listen on '" << socket_path << "': " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    setNonBlocking(fd);
+
+    this->_socket_path = socket_path;
+    this->_listen_fd = fd;
+    std::cout << "calibration service listening on '" << socket_path << "'" << std::endl;
+    return true;
+}
+
+
+void CalibrationService::run() {
+
+    this->_running = this->_listen_fd >= 0;
+    std::vector<pollfd> poll_fds;
+
+    while (this->_running) {
+
+        poll_fds.clear();
+        poll_fds.push_back(pollfd{this->_listen_fd, POLLIN, 0});
+        for (auto const &client : this->_clients) {
+            short events = client.eof ? 0 : POLLIN;
+            if (!client.output.empty()) {
+                events |= POLLOUT;
+            }
+            poll_fds.push_back(pollfd{client.fd, events, 0});
+        }
+
+        if (poll(poll_fds.data(), poll_fds.size(), POLL_TIMEOUT_MS) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cout << "calibration service poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        // clients are walked backwards so closing one keeps the remaining poll entries in place
+        for (unsigned long i = this->_clients.size(); i-- > 0;) {
+            short events = poll_fds[i + 1].revents;
+            bool alive = true;
+            if (events & (POLLIN | POLLHUP | POLLERR)) {
+                alive = this->readClient(&this->_clients[i]);
+            }
+            if (alive && (events & POLLOUT)) {
+                alive = this->writeClient(&this->_clients[i]);
+            }
+            if (!alive) {
+                this->closeClient(i);
+            }
+        }
+
+        if (poll_fds[0].revents & POLLIN) {
+            this->acceptClients();
+        }
+
+        if (!this->_requests.empty()) {
+            this->processRequests();
+        }
+
+        // clients which stopped sending get closed once everything got answered
+        for (unsigned long i = this->_clients.size(); i-- > 0;) {
+            if (this->_clients[i].eof && this->_clients[i].output.empty()) {
+                this->closeClient(i);
+            }
+        }
+    }
+}
+
+
+void CalibrationService::stop() {
+    this->_running = false;
+}
+
+
+void CalibrationService::acceptClients() {
+    for (;;) {
+        int fd = accept(this->_listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        setNonBlocking(fd);
+
+        Client client;
+        client.fd = fd;
+        client.eof = false;
+        this->_clients.push_back(client);
+    }
+}
+
+
+bool CalibrationService::readClient(Client *client) {
+
+    char buffer[4096];
+    for (;;) {
+        ssize_t num_bytes = recv(client->fd, buffer, sizeof(buffer), 0);
+        if (num_bytes > 0) {
+            client->input.append(buffer, (unsigned long) num_bytes);
+            if (client->input.size() > MAX_REQUEST_BYTES) {
+                return false;
+            }
+        } else if (num_bytes == 0) {
+            client->eof = true;
+            break;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+
+    unsigned long line_begin = 0;
+    unsigned long line_end;
+    while ((line_end = client->input.find('\n', line_begin)) != std::string::npos) {
+        std::string line = client->input.substr(line_begin, line_end - line_begin);
+        line_begin = line_end + 1;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        std::string error;
+        json11::Json message = json11::Json::parse(line, error);
+        if (!error.empty() || !message.is_object()) {
+            this->reply(client->fd, json11::Json::object{
+                    {"status", "error"},
+                    {"error",  error.empty() ? std::string("request is no json object") : error}
+            });
+            continue;
+        }
+
+        Request request;
+        request.fd = client->fd;
+        request.message = message;
+        this->_requests.push_back(request);
+    }
+    client->input.erase(0, line_begin);
+    return true;
+}
+
+
+bool CalibrationService::writeClient(Client *client) {
+    while (!client->output.empty()) {
+        ssize_t num_bytes = send(client->fd, client->output.data(), client->output.size(), MSG_NOSIGNAL);
+        if (num_bytes > 0) {
+            client->output.erase(0, (unsigned long) num_bytes);
+        } else if (num_bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else if (num_bytes < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void CalibrationService::processRequests() {
+
+    auto start = std::chrono::steady_clock::now();
+
+    // merge all queued requests, later values win
+    std::vector<Request> requests;
+    requests.swap(this->_requests);
+
+    std::vector<Request> accepted;
+    bool send_mesh = false;
+    float fov = 0.0f;
+    for (auto const &request : requests) {
+        if (request.message["command"].string_value() == "shutdown") {
+            this->reply(request.fd, json11::Json::object{{"id", request.message["id"]}, {"status", "ok"}});
+            this->_running = false;
+            continue;
+        }
+
+        std::string error;
+        if (!this->applyRequest(request.message, &error)) {
+            this->reply(request.fd, json11::Json::object{
+                    {"id",     request.message["id"]},
+                    {"status", "error"},
+                    {"error",  error}
+            });
+            continue;
+        }
+
+        if (request.message["projector"]["fov"].is_number()) {
+            fov = (float) request.message["projector"]["fov"].number_value();
+        }
+        send_mesh |= request.message["reply"].string_value() == "mesh";
+        accepted.push_back(request);
+    }
+
+    if (accepted.empty()) {
+        return;
+    }
+
+    // only a new field of view invalidates the sample grid
+    if (fov > 0.0f) {
+        Screen const &screen = this->_projector->get_screen();
+        glm::mat4 projection = glm::perspective(glm::radians(fov),
+                                                float(screen.width) / float(screen.height),
+                                                PROJECTOR_NEAR,
+                                                PROJECTOR_FAR);
+        this->_projector->set_frustum(new Frustum(projection, this->_projector->get_position(), false));
+    }
+
+    this->_projector->calculateDomeHitpoints(this->_mirror, this->_dome);
+    this->_projector->calculateTransformationMesh();
+
+    bool published = this->_publisher != nullptr && this->_publisher->is_open() &&
+                     this->_publisher->publish(this->_projector->get_mesh());
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    json11::Json metrics = this->metricsToJson();
+    json11::Json mesh = send_mesh ? this->meshToJson() : json11::Json();
+    for (auto const &request : accepted) {
+        json11::Json::object message{
+                {"id",         request.message["id"]},
+                {"status",     "ok"},
+                {"coalesced",  (int) accepted.size()},
+                {"elapsed_ms", elapsed_ms},
+                {"published",  published},
+                {"metrics",    metrics}
+        };
+        if (request.message["reply"].string_value() == "mesh") {
+            message["mesh"] = mesh;
+        }
+        this->reply(request.fd, message);
+    }
+}
+
+
+bool CalibrationService::applyRequest(json11::Json const &message, std::string *error) {
+
+    // validate everything first, so a rejected request leaves the model untouched
+    glm::vec3 mirror_position = this->_mirror->get_position();
+    glm::vec3 dome_position = this->_dome->get_position();
+    float mirror_radius = this->_mirror->get_radius();
+    float dome_radius = this->_dome->get_radius();
+
+    json11::Json const &mirror = message["mirror"];
+    json11::Json const &dome = message["dome"];
+    json11::Json const &projector = message["projector"];
+
+    if (!mirror["position"].is_null() && !readVec3(mirror["position"], &mirror_position)) {
+        *error = "mirror.position must be an array of three numbers";
+        return false;
+    }
+    if (!dome["position"].is_null() && !readVec3(dome["position"], &dome_position)) {
+        *error = "dome.position must be an array of three numbers";
+        return false;
+    }
+    if (mirror["radius"].is_number()) {
+        mirror_radius = (float) mirror["radius"].number_value();
+    }
+    if (dome["radius"].is_number()) {
+        dome_radius = (float) dome["radius"].number_value();
+    }
+    if (mirror_radius <= 0.0f || dome_radius <= 0.0f) {
+        *error = "radii must be positive";
+        return false;
+    }
+    if (projector["fov"].is_number() &&
+        (projector["fov"].number_value() <= 0.0 || projector["fov"].number_value() >= 180.0)) {
+        *error = "projector.fov must lie between 0 and 180 degrees";
+        return false;
+    }
+
+    this->_mirror->set_position(mirror_position);
+    this->_mirror->set_radius(mirror_radius);
+    this->_dome->set_position(dome_position);
+    this->_dome->set_radius(dome_radius);
+    return true;
+}
+
+
+void CalibrationService::reply(int fd, json11::Json const &message) {
+    for (auto &client : this->_clients) {
+        if (client.fd == fd) {
+            client.output += message.dump();
+            client.output += '\n';
+            this->writeClient(&client);
+            return;
+        }
+    }
+}
+
+
+void CalibrationService::closeClient(unsigned long client_idx) {
+    int fd = this->_clients[client_idx].fd;
+    ::close(fd);
+    this->_clients.erase(this->_clients.begin() + client_idx);
+
+    // requests of a vanished client need no answer
+    for (unsigned long i = this->_requests.size(); i-- > 0;) {
+        if (this->_requests[i].fd == fd) {
+            this->_requests.erase(this->_requests.begin() + i);
+        }
+    }
+}
+
+
+json11::Json CalibrationService::metricsToJson() const {
+    MappingMetrics const &metrics = this->_projector->get_metrics();
+    return json11::Json::object{
+            {"rays",               (int) metrics.num_rays},
+            {"mirror_misses",      (int) metrics.num_mirror_misses},
+            {"dome_misses",        (int) metrics.num_dome_misses},
+            {"below_equator",      (int) metrics.num_below_equator},
+            {"vertices",           (int) metrics.num_vertices},
+            {"unmapped_vertices",  (int) metrics.num_unmapped_vertices},
+            {"coverage",           metrics.coverage()},
+            {"tolerance",          metrics.tolerance},
+            {"mean_snap_distance", metrics.mean_snap_distance},
+            {"max_snap_distance",  metrics.max_snap_distance}
+    };
+}
+
+
+json11::Json CalibrationService::meshToJson() const {
+    DomeMesh const &mesh = this->_projector->get_mesh();
+
+    json11::Json::array vertices(mesh.vertices.begin(), mesh.vertices.end());
+    json11::Json::array indices;
+    indices.reserve(mesh.numIndices());
+    for (unsigned long i = 0; i < mesh.numIndices(); ++i) {
+        indices.push_back((int) mesh.index(i));
+    }
+
+    return json11::Json::object{
+            {"floats_per_vertex", DomeMesh::FLOATS_PER_VERTEX},
+            {"vertices",          vertices},
+            {"indices",           indices}
+    };
+}
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include "ConfigWatcher.hpp"
+
+// interval of the modification time checks where inotify is not available
+#define POLL_INTERVAL_MS 200
+
+static std::string directoryOf(std::string const &path) {
+    unsigned long separator = path.find_last_of('/');
+    return separator == std::string::npos ? std::string(".") : path.substr(0, separator);
+}
+
+static std::string fileNameOf(std::string const &path) {
+    unsigned long separator = path.find_last_of('/');
+    return separator == std::string::npos ? path : path.substr(separator + 1);
+}
+
+static long modificationTime(std::string const &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? (long) info.st_mtime : 0;
+}
+
+/**
+ * c'tor
+ * @param paths
+ * @param debounce_ms
+ * @param callback
+ */
+ConfigWatcher::ConfigWatcher(std::vector<std::string> const &paths, int debounce_ms, Callback const &callback)
+        : _paths(paths)
+        , _debounce_ms(std::max(debounce_ms, 0))
+        , _callback(callback)
+        , _running(false)
+        , _notify_fd(-1) {
+    _wake_fds[0] = -1;
+    _wake_fds[1] = -1;
+}
+
+
+ConfigWatcher::~ConfigWatcher() {
+    this->stop();
+}
+
+
+bool ConfigWatcher::start() {
+
+    if (this->_running) {
+        return true;
+    }
+
+#ifdef __linux__
+    this->_notify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (this->_notify_fd < 0 || pipe(this->_wake_fds) != 0) {
+        std::cout << "failed to set up the config watcher" << std::endl;
+        this->stop();
+        return false;
+    }
+
+    this->_directories.clear();
+    this->_watch_descriptors.clear();
+    for (auto const &path : this->_paths) {
+        std::string directory = directoryOf(path);
+        if (std::find(this->_directories.begin(), this->_directories.end(), directory) != this->_directories.end()) {
+            continue;
+        }
+
+        int wd = inotify_add_watch(this->_notify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (wd < 0) {
+            std::cout << "failed to watch '" << directory << "'" << std::endl;
+            this->stop();
+            return false;
+        }
+        this->_directories.push_back(directory);
+        this->_watch_descriptors.push_back(wd);
+    }
+#else
+    this->_modification_times.clear();
+    for (auto const &path : this->_paths) {
+        this->_modification_times.push_back(modificationTime(path));
+    }
+#endif
+
+    this->_running = true;
+    this->_thread = std::thread(&ConfigWatcher::watch, this);
+    return true;
+}
+
+
+void ConfigWatcher::stop() {
+
+    this->_running = false;
+#ifdef __linux__
+    if (this->_wake_fds[1] >= 0) {
+        char wake = 0;
+        ssize_t ignored = write(this->_wake_fds[1], &wake, 1);
+        (void) ignored;
+    }
+#endif
+
+    if (this->_thread.joinable()) {
+        this->_thread.join();
+    }
+
+    for (int fd : {this->_notify_fd, this->_wake_fds[0], this->_wake_fds[1]}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    this->_notify_fd = -1;
+    this->_wake_fds[0] = -1;
+    this->_wake_fds[1] = -1;
+}
+
+
+void ConfigWatcher::watch() {
+
+    std::vector<std::string> changed;
+    std::vector<std::string> more;
+
+    while (this->_running) {
+        changed.clear();
+        this->waitForChanges(-1, &changed);
+
+        // keep collecting until the files stayed untouched for the debounce time
+        do {
+            more.clear();
+            this->waitForChanges(this->_debounce_ms, &more);
+            for (auto const &path : more) {
+                if (std::find(changed.begin(), changed.end(), path) == changed.end()) {
+                    changed.push_back(path);
+                }
+            }
+        } while (!more.empty() && this->_running);
+
+        if (this->_running && !changed.empty()) {
+            this->_callback(changed);
+        }
+    }
+}
+
+
+void ConfigWatcher::waitForChanges(int timeout_ms, std::vector<std::string> *changed) {
+
+#ifdef __linux__
+    // other files in the watched directories wake up the poll as well, those do not end the wait
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (changed->empty() && this->_running) {
+        int remaining_ms = -1;
+        if (timeout_ms >= 0) {
+            remaining_ms = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+            if (remaining_ms <= 0) {
+                return;
+            }
+        }
+
+        pollfd poll_fds[2] = {{this->_notify_fd, POLLIN, 0},
+                              {this->_wake_fds[0], POLLIN, 0}};
+        if (poll(poll_fds, 2, remaining_ms) <= 0 || !this->_running) {
+            return;
+        }
+        this->readEvents(changed);
+    }
+#else
+    auto start = std::chrono::steady_clock::now();
+    while (this->_running) {
+        for (unsigned long i = 0; i < this->_paths.size(); ++i) {
+            long time = modificationTime(this->_paths[i]);
+            if (time != this->_modification_times[i]) {
+                this->_modification_times[i] = time;
+                changed->push_back(this->_paths[i]);
+            }
+        }
+
+        long elapsed_ms = (long) std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        if (!changed->empty() || (timeout_ms >= 0 && elapsed_ms >= timeout_ms)) {
+            return;
+        }
+        usleep(POLL_INTERVAL_MS * 1000);
+    }
+#endif
+}
+
+
+#ifdef __linux__
+void ConfigWatcher::readEvents(std::vector<std::string> *changed) {
+
+    // events are aligned to their header, reading whole batches keeps them intact
+    alignas(inotify_event) char buffer[4096];
+    ssize_t num_bytes;
+    while ((num_bytes = read(this->_notify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *ptr = buffer; ptr < buffer + num_bytes;) {
+            inotify_event const *event = (inotify_event const *) ptr;
+            ptr += sizeof(inotify_event) + event->len;
+            if (event->len == 0) {
+                continue;
+            }
+
+            auto wd = std::find(this->_watch_descriptors.begin(), this->_watch_descriptors.end(), event->wd);
+            if (wd == this->_watch_descriptors.end()) {
+                continue;
+            }
+            std::string const &directory = this->_directories[wd - this->_watch_descriptors.begin()];
+
+            for (auto const &path : this->_paths) {
+                if (directoryOf(path) == directory && fileNameOf(path) == event->name &&
+                    std::find(changed->begin(), changed->end(), path) == changed->end()) {
+                    changed->push_back(path);
+                }
+            }
+        }
+    }
+}
+#endif
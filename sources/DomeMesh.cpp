@@ -0,0 +1,73 @@
+#include <limits>
+
+#include "DomeMesh.hpp"
+
+/**
+ * c'tor
+ */
+DomeMesh::DomeMesh() {}
+
+
+void DomeMesh::setTriangles(std::vector<unsigned int> const &indices, unsigned long num_vertices) {
+    indices16.clear();
+    indices32.clear();
+
+    if (num_vertices <= std::numeric_limits<unsigned short>::max()) {
+        indices16.assign(indices.begin(), indices.end());
+    } else {
+        indices32 = indices;
+    }
+}
+
+
+void DomeMesh::setVertices(std::vector<glm::vec3> const &screen_points,
+                           std::vector<glm::vec3> const &texture_coords) {
+
+    vertices.resize(screen_points.size() * FLOATS_PER_VERTEX);
+    for (unsigned long i = 0; i < screen_points.size(); ++i) {
+        float *vertex = &vertices[i * FLOATS_PER_VERTEX];
+        vertex[0] = screen_points[i].x;
+        vertex[1] = screen_points[i].y;
+        vertex[2] = texture_coords[i].x;
+        vertex[3] = texture_coords[i].y;
+    }
+}
+
+
+bool DomeMesh::is16Bit() const {
+    return indices32.empty();
+}
+
+
+unsigned long DomeMesh::numVertices() const {
+    return vertices.size() / FLOATS_PER_VERTEX;
+}
+
+
+unsigned long DomeMesh::numIndices() const {
+    return is16Bit() ? indices16.size() : indices32.size();
+}
+
+
+void const *DomeMesh::indexData() const {
+    if (is16Bit()) {
+        return indices16.data();
+    }
+    return indices32.data();
+}
+
+
+unsigned long DomeMesh::indexBytes() const {
+    if (is16Bit()) {
+        return indices16.size() * sizeof(unsigned short);
+    }
+    return indices32.size() * sizeof(unsigned int);
+}
+
+
+unsigned int DomeMesh::index(unsigned long i) const {
+    if (is16Bit()) {
+        return indices16[i];
+    }
+    return indices32[i];
+}
@@ -3,6 +3,8 @@
 //
 
 #include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -10,39 +12,50 @@
 #include "DomeProjector.hpp"
 #include "Utility.hpp"
 #include "Sphere.hpp"
+#include "Parallel.hpp"
+#include "Exporter.hpp"
+
+// position stored for rays which did not make it into the upper dome half
+#define MISS_POSITION glm::vec3(1000.0f, 1000.0f, 1000.0f)
+
+// number of buckets of the snap distance histogram
+#define SNAP_HISTOGRAM_BINS 10
+
+// triangles with edges longer than this multiple of the median edge are dropped
+#define MAX_EDGE_FACTOR 8.0f
+
+// tolerance for points lying on a triangles edge
+#define BARYCENTRIC_EPSILON 0.0001f
+
+// number of rays traced by a worker before it picks the next tile
+#define RAY_TILE_SIZE 4096
+
+// footprint that gets the full brightness, larger footprints are clamped.
+// The widest few percent sit at the rim and would darken everything else.
+#define BRIGHTNESS_REFERENCE_PERCENTILE 0.95f
 
 DomeProjector::DomeProjector(Frustum *_frustum,
                              Screen *_screen,
-                             int _grid_rings,
-                             int _grid_ring_elements,
+                             GridGenerator const &grid_generator,
                              glm::vec3 const &position,
                              int dome_rings,
                              int dome_ring_elements)
         : _frustum(_frustum)
         , _screen(_screen)
-        , _grid_rings(_grid_rings)
-        , _grid_ring_elements(_grid_ring_elements)
         , _position(position)
+        , _grid_generator(grid_generator)
+        , _generation(0)
         , _dome_rings(dome_rings)
-        , _dome_ring_elements(dome_ring_elements) {
-
-    this->generateRadialGrid();
+        , _dome_ring_elements(dome_ring_elements)
+        , _dome_tessellation(LAT_LONG)
+        , _dome_subdivisions(0)
+        , _ray_differentials(false)
+        , _dome_radius(1.0f)
+        , _snap_tolerance(0.01f)
+        , _mapping_mode(NEAREST) {
+
+    this->generateSampleGrid();
     this->generateDomeVertices();
-
-    glm::mat4 scale_mat(1.0f);
-    scale_mat = glm::scale(scale_mat, glm::vec3(1.6f, 1.6f, 1.6f));
-
-    for (int j = 0; j < this->_dome_vertices.size(); ++j) {
-        glm::vec4 res = scale_mat * glm::vec4(this->_dome_vertices[j], 1.0f);
-        this->_dome_vertices[j] = glm::vec3(res);
-    }
-
-    // translate sample grid to projector position
-    // ignore the first element which is already in the frustums center
-    for (int i = 1; i < this->_sample_grid.size(); ++i) {
-        this->_sample_grid[i] = this->_sample_grid[i] + position;
-    }
-
 }
 
 
@@ -54,50 +67,89 @@ DomeProjector::~DomeProjector() {
 
 std::vector<glm::vec3> DomeProjector::calculateTransformationMesh() {
 
-    // create green list here
-    std::map<int, int> map;
+    ++this->_generation;
 
-    float last_distance = std::numeric_limits<float>::max();
-    int last_hitpoint_idx = 0;
+    this->_metrics.resetSnaps(this->_snap_tolerance, SNAP_HISTOGRAM_BINS);
+    this->calculateBrightness();
 
-    for (int vert_idx = 0; vert_idx < this->_dome_vertices.size(); ++vert_idx) {
-        for (int hp_idx = 0; hp_idx < this->_second_hits.size(); ++hp_idx) {
-//            float current_distance = glm::length(this->_dome_vertices[vert_idx] - this->_second_hits[hp_idx]);
-            float current_distance = glm::length(this->_second_hits[hp_idx] - this->_dome_vertices[vert_idx]);
-            if (current_distance < last_distance) {
-//                std::cout << "distance: " << current_distance << std::endl;
-                last_distance = current_distance;
-                last_hitpoint_idx = hp_idx;
-            }
+    if (this->_grid_generator.get_layout() == GridGenerator::PIXEL) {
+        // pixels map straight to their hits, there is nothing to search
+        this->_vertex_samples.clear();
+        this->_mapping_seeds.clear();
+        this->calculatePixelMapping();
+        this->_vertex_gains.resize(this->_brightness.size());
+        for (unsigned long i = 0; i < this->_brightness.size(); ++i) {
+            this->_vertex_gains[i] = this->_brightness[i].gain;
         }
-        last_distance = std::numeric_limits<float>::max();
-//        std::cout << "dome idx: " << vert_idx << " hp idx: " << last_hitpoint_idx << std::endl;
-        map.insert(std::pair<int, int>(vert_idx, last_hitpoint_idx));
+        return std::vector<glm::vec3>();
     }
 
-    std::vector<glm::vec3> corresponding_hitpoints;
-    for (auto pair : map) {
-        corresponding_hitpoints.push_back(this->_sample_grid[pair.first]);
-//        corresponding_hitpoints.push_back(this->_second_hits[pair.second]);
+    // seeds of a coarser level turn every nearest hit search into a short walk
+    bool seeded = this->_mapping_seeds.size() == this->_dome_vertices.size();
+    if (this->_mapping_mode == BARYCENTRIC) {
+        this->buildSampleTriangles();
+    }
+    if (this->_mapping_mode == WALK || seeded) {
+        this->buildHitGrid();
     }
-
-    this->corresponding_hitpoints = corresponding_hitpoints;
 
     // calculate mapping
     std::vector<glm::vec3> screen_points;
     std::vector<glm::vec3> texture_points;
+    this->_vertex_gains.clear();
+    this->_vertex_samples.assign(this->_dome_vertices.size(), -1);
 
-    for (auto pair : map) {
+    // neighbouring dome vertices land in neighbouring grid cells, so each walk starts at the last result
+    int last_hit_idx = -1;
 
-        std::cout << "dome: " << pair.first << " texture " << pair.second << std::endl;
+    for (int vert_idx = 0; vert_idx < this->_dome_vertices.size(); ++vert_idx) {
 
-        texture_points.push_back(this->_dome_vertices[pair.first]);
-        screen_points.push_back(this->_sample_grid[pair.second]);
+        glm::vec3 const &vertex = this->_dome_vertices[vert_idx];
+        glm::vec3 sample_point;
+        float gain = 1.0f;
+        float distance = 0.0f;
+
+        // interpolate within the surrounding hit triangle and snap to the nearest hit otherwise
+        unsigned int const *corners;
+        glm::vec3 weights;
+        bool mapped = this->_mapping_mode == BARYCENTRIC &&
+                      this->findSampleTriangle(vertex, &corners, &weights, &distance);
+        if (mapped) {
+            sample_point = glm::vec3(0.0f);
+            gain = 0.0f;
+            for (int corner = 0; corner < 3; ++corner) {
+                sample_point += weights[corner] * this->_sample_grid[corners[corner]];
+                gain += weights[corner] * this->_brightness[corners[corner]].gain;
+            }
+            int heaviest = weights.x >= weights.y ? (weights.x >= weights.z ? 0 : 2) : (weights.y >= weights.z ? 1 : 2);
+            this->_vertex_samples[vert_idx] = (int) corners[heaviest];
+        } else {
+            int hit_idx;
+            if (seeded) {
+                hit_idx = this->walkToNearestHit(vertex, this->_mapping_seeds[vert_idx], &distance);
+            } else if (this->_mapping_mode == WALK) {
+                hit_idx = this->walkToNearestHit(vertex, last_hit_idx, &distance);
+                last_hit_idx = hit_idx;
+            } else {
+                hit_idx = this->findNearestHit(vertex, &distance);
+            }
+            mapped = hit_idx >= 0;
+            sample_point = this->_sample_grid[mapped ? hit_idx : 0];
+            gain = mapped ? this->_brightness[hit_idx].gain : 1.0f;
+            this->_vertex_samples[vert_idx] = hit_idx;
+        }
 
-//        texture_points.push_back(this->_dome_vertices[pair.second]);
-//        screen_points.push_back(this->_sample_grid[pair.first]);
+        if (mapped) {
+            this->_metrics.addSnap(distance);
+        } else {
+            this->_metrics.addUnmapped();
+        }
 
+        texture_points.push_back(vertex);
+        screen_points.push_back(sample_point);
+        this->_vertex_gains.push_back(gain);
     }
+    this->_mapping_seeds.clear();
 
     // normalize screen list
     float screen_min_x = utility::findMinValues(screen_points).x;
@@ -141,100 +193,755 @@ std::vector<glm::vec3> DomeProjector::calculateTransformationMesh() {
     this->_screen_points = screen_points_normalized;
     this->_texture_coords = texture_coords_normalized;
 
+    this->_mesh.setTriangles(this->_dome_indices, this->_screen_points.size());
+    this->_mesh.setVertices(this->_screen_points, this->_texture_coords);
+
     return std::vector<glm::vec3>();
 }
 
 
+void DomeProjector::seedMapping(DomeProjector const &coarse) {
+
+    this->_mapping_seeds.clear();
+
+    // grid positions only carry over between grids of the same kind
+    SampleGrid const &grid = this->_grid;
+    SampleGrid const &coarse_grid = coarse._grid;
+    if (coarse._vertex_samples.size() != coarse._dome_unit_vertices.size() ||
+        coarse._grid_generator.get_layout() != this->_grid_generator.get_layout() ||
+        !grid.structured() || !coarse_grid.structured() ||
+        grid.has_center != coarse_grid.has_center) {
+        return;
+    }
+
+    // both tessellations cover the unit half sphere, any point on it lies
+    // within an edge of its closest coarse vertex
+    std::vector<glm::vec3> const &coarse_vertices = coarse._dome_unit_vertices;
+    std::vector<unsigned int> const &coarse_indices = coarse._dome_indices;
+    float max_edge = 0.0f;
+    for (unsigned long i = 0; i + 2 < coarse_indices.size(); i += 3) {
+        glm::vec3 const &a = coarse_vertices[coarse_indices[i]];
+        glm::vec3 const &b = coarse_vertices[coarse_indices[i + 1]];
+        glm::vec3 const &c = coarse_vertices[coarse_indices[i + 2]];
+        max_edge = std::max(max_edge, std::max(glm::length(b - a), std::max(glm::length(c - b), glm::length(a - c))));
+    }
+
+    std::vector<glm::vec3> box_min(coarse_vertices.size());
+    std::vector<glm::vec3> box_max(coarse_vertices.size());
+    for (unsigned long i = 0; i < coarse_vertices.size(); ++i) {
+        box_min[i] = coarse_vertices[i] - glm::vec3(max_edge);
+        box_max[i] = coarse_vertices[i] + glm::vec3(max_edge);
+    }
+    SpatialGrid vertex_grid;
+    vertex_grid.build(box_min, box_max, std::max((int) std::cbrt((double) coarse_vertices.size()), 1));
+
+    this->_mapping_seeds.assign(this->_dome_unit_vertices.size(), -1);
+    for (unsigned long vert_idx = 0; vert_idx < this->_dome_unit_vertices.size(); ++vert_idx) {
+        glm::vec3 const &vertex = this->_dome_unit_vertices[vert_idx];
+
+        int const *begin;
+        int const *end;
+        vertex_grid.query(vertex, &begin, &end);
+        int nearest_idx = -1;
+        float nearest_distance = std::numeric_limits<float>::max();
+        for (int const *it = begin; it != end; ++it) {
+            float vertex_distance = glm::length(coarse_vertices[*it] - vertex);
+            if (vertex_distance < nearest_distance) {
+                nearest_distance = vertex_distance;
+                nearest_idx = *it;
+            }
+        }
+
+        int coarse_sample = nearest_idx < 0 ? -1 : coarse._vertex_samples[nearest_idx];
+        if (coarse_sample < 0) {
+            continue;
+        }
+        if (coarse_grid.has_center && coarse_sample == 0) {
+            this->_mapping_seeds[vert_idx] = 0;
+            continue;
+        }
+
+        // the same relative row and column of the finer grid
+        int row = (coarse_sample - coarse_grid.index(0, 0)) / coarse_grid.columns;
+        int column = (coarse_sample - coarse_grid.index(0, 0)) % coarse_grid.columns;
+        int seed_row = std::min((int) ((row + 0.5f) * grid.rows / coarse_grid.rows), grid.rows - 1);
+        int seed_column = std::min((int) ((column + 0.5f) * grid.columns / coarse_grid.columns), grid.columns - 1);
+        this->_mapping_seeds[vert_idx] = grid.index(seed_row, seed_column);
+    }
+}
+
+
 void DomeProjector::calculateDomeHitpoints(Sphere *mirror, Sphere *dome) {
 
-    this->_first_hits.clear();
-    this->_second_hits.clear();
+    // views handed out so far are about to go stale
+    ++this->_generation;
 
-    // translate dome vertices to the domes position
+    // place the unit dome vertices on the dome, starting from the unit vertices keeps repeated calls from drifting
     for (int i = 0; i < this->_dome_vertices.size(); ++i) {
-        this->_dome_vertices[i] += dome->get_position();
-        // todo move translation to scaling
+        this->_dome_vertices[i] = this->_dome_unit_vertices[i] * dome->get_radius() + dome->get_position();
+    }
+
+    this->_dome_center = dome->get_position();
+    this->_dome_radius = dome->get_radius();
+
+    // every sample owns its slot, so tiles of samples are traced independently
+    unsigned long num_samples = this->_sample_grid.size();
+    this->_first_hits.assign(num_samples, MISS_POSITION);
+    this->_second_hits.assign(num_samples, MISS_POSITION);
+    this->_ray_status.assign(num_samples, MIRROR_MISS);
+
+    // a pixel step on the near plane, y pointing up like the sample grid
+    std::vector<glm::vec3> const &corners = this->_frustum->_near_clipping_corners;
+    this->_pixel_step_x = (corners[1] - corners[0]) / (float) this->_screen->width;
+    this->_pixel_step_y = (corners[0] - corners[3]) / (float) this->_screen->height;
+    FootprintEllipse lost = {glm::vec3(0.0f), glm::vec3(0.0f)};
+    if (this->_ray_differentials) {
+        this->_footprint_ellipses.assign(num_samples, lost);
+    } else {
+        this->_footprint_ellipses.clear();
+    }
+
+    parallel::forTiles(0, (long) num_samples, RAY_TILE_SIZE, [&](long begin, long end) {
+        for (long i = begin; i < end; ++i) {
+            this->castRay((unsigned long) i, mirror, dome);
+        }
+    });
+
+    this->_metrics.resetRays(this->_dome_rings);
+    this->_metrics.num_rays = (unsigned int) num_samples;
+    for (unsigned long i = 0; i < num_samples; ++i) {
+        switch (this->_ray_status[i]) {
+            case DOME_HIT:
+                this->countRingHit(this->_second_hits[i], dome);
+                break;
+            case MIRROR_MISS:
+                ++this->_metrics.num_mirror_misses;
+                break;
+            case DOME_MISS:
+                ++this->_metrics.num_dome_misses;
+                break;
+            case BELOW_EQUATOR:
+                ++this->_metrics.num_below_equator;
+                break;
+        }
+    }
+
+    // hits per square unit of each ring band
+    float delta_phi = glm::radians(90.0f / (float) this->_metrics.ring_hits.size());
+    float radius = dome->get_radius();
+    for (unsigned long ring_idx = 0; ring_idx < this->_metrics.ring_hits.size(); ++ring_idx) {
+        float band_area = 2.0f * (float) M_PI * radius * radius *
+                          (std::cos(ring_idx * delta_phi) - std::cos((ring_idx + 1) * delta_phi));
+        this->_metrics.ring_hit_density[ring_idx] = this->_metrics.ring_hits[ring_idx] / band_area;
+    }
+
+}
+
+
+/**
+ * Principal semi axes of the parallelogram spanned by the two pixel steps on the surface
+ * @param step_x
+ * @param step_y
+ * @return
+ */
+static DomeProjector::FootprintEllipse footprintEllipse(glm::vec3 const &step_x, glm::vec3 const &step_y) {
+
+    // eigen decomposition of the 2x2 gram matrix of the steps
+    float a = glm::dot(step_x, step_x);
+    float b = glm::dot(step_x, step_y);
+    float c = glm::dot(step_y, step_y);
+    float major = 0.5f * (a + c) + std::sqrt(0.25f * (a - c) * (a - c) + b * b);
+
+    // eigenvector of the major eigenvalue, in pixel steps. The steps along both
+    // eigenvectors are orthogonal on the surface and as long as the semi axes.
+    glm::vec2 direction = a >= c ? glm::vec2(major - c, b) : glm::vec2(b, major - a);
+    if (glm::dot(direction, direction) == 0.0f) {
+        direction = glm::vec2(1.0f, 0.0f);
     }
+    direction = glm::normalize(direction);
 
-    // raycast for each samplepoint
-    for (int i = 0; i < this->_sample_grid.size(); ++i) {
+    DomeProjector::FootprintEllipse ellipse;
+    ellipse.major_axis = direction.x * step_x + direction.y * step_y;
+    ellipse.minor_axis = -direction.y * step_x + direction.x * step_y;
+    return ellipse;
+}
 
-        // todo ignore points outside of the frustum
-//        if (this->_sample_grid[i].y > _frustum->_near_clipping_corners[3].y &&
-//            this->_sample_grid[i].y < _frustum->_near_clipping_corners[0].y) {
-//            break;
-//        }
 
-        // calculate initial ray direction
-        glm::vec3 initial_direction = this->_sample_grid[i] - this->_position;
+void DomeProjector::castRay(unsigned long sample_idx, Sphere *mirror, Sphere *dome) {
 
-        // build ray and define hitpoint
-        Ray r(this->_position, glm::normalize(initial_direction));
-        std::pair<Hitpoint, Hitpoint> hpp;
-        if (mirror->intersect(r, &hpp)) {
+    // calculate initial ray direction
+    glm::vec3 initial_direction = this->_sample_grid[sample_idx] - this->_position;
 
-            this->_first_hits.push_back(hpp.first.position);
+    // build ray and define hitpoint
+    Ray r(this->_position, glm::normalize(initial_direction));
+    if (this->_ray_differentials) {
+        // derivative of the normalized direction towards the neighbouring pixels, the origin stays put
+        float length = glm::length(initial_direction);
+        glm::vec3 direction_dx = (this->_pixel_step_x - r.direction * glm::dot(r.direction, this->_pixel_step_x)) / length;
+        glm::vec3 direction_dy = (this->_pixel_step_y - r.direction * glm::dot(r.direction, this->_pixel_step_y)) / length;
+        r.setDifferentials(glm::vec3(0.0f), glm::vec3(0.0f), direction_dx, direction_dy);
+    }
+    // the mirror bounce only needs the near hit, the dome bounce only the far one
+    Hitpoint mirror_hit;
+    if (!mirror->intersectNear(r, &mirror_hit)) {
+        this->_ray_status[sample_idx] = MIRROR_MISS;
+        return;
+    }
 
-            // reflect ray
-            glm::vec3 ref = r.reflect(hpp.first.normal);
+    this->_first_hits[sample_idx] = mirror_hit.position;
 
-            Ray r2(hpp.first.position, glm::normalize(ref));
-            std::pair<Hitpoint, Hitpoint> hpp2;
-            if (dome->intersect(r2, &hpp2)) {
-                if (hpp2.second.position.y > dome->get_position().y) {
-                    this->_second_hits.push_back(hpp2.second.position);
-                } else {
-                    this->_second_hits.push_back(glm::vec3(1000, 1000, 1000));
-                }
-            } else {
-                this->_second_hits.push_back(glm::vec3(1000, 1000, 1000));
-            }
+    // reflect ray
+    Ray r2 = r.reflectAt(mirror_hit);
+    Hitpoint dome_hit;
+    if (!dome->intersectFar(r2, &dome_hit)) {
+        this->_ray_status[sample_idx] = DOME_MISS;
+        return;
+    }
 
+    if (dome_hit.position.y > dome->get_position().y) {
+        this->_second_hits[sample_idx] = dome_hit.position;
+        this->_ray_status[sample_idx] = DOME_HIT;
+        if (this->_ray_differentials) {
+            this->_footprint_ellipses[sample_idx] = footprintEllipse(dome_hit.position_dx,
+                                                                     dome_hit.position_dy);
+        }
+    } else {
+        this->_ray_status[sample_idx] = BELOW_EQUATOR;
+    }
+}
+
+
+void DomeProjector::calculatePixelMapping() {
+
+    // each sample already is a pixel, its texture coordinate comes straight from its dome hit
+    unsigned long num_samples = this->_second_hits.size();
+    this->_screen_points.resize(num_samples);
+    this->_texture_coords.resize(num_samples);
+    this->_pixel_lut.resize(num_samples);
+
+    SampleGrid const &grid = this->_grid;
+    glm::vec2 half_extent(std::abs(this->_frustum->_near_clipping_corners[1].x -
+                                   this->_frustum->_near_clipping_corners[0].x) / 2,
+                          std::abs(this->_frustum->_near_clipping_corners[1].y -
+                                   this->_frustum->_near_clipping_corners[2].y) / 2);
+
+    for (unsigned long i = 0; i < num_samples; ++i) {
+        this->_screen_points[i] = glm::vec3(grid.x[i] / half_extent.x, grid.y[i] / half_extent.y, 0.0f);
+
+        if (this->_ray_status[i] == DOME_HIT) {
+            // top view of the dome, matching the normalized texture coordinates of the mesh
+            glm::vec3 local = (this->_second_hits[i] - this->_dome_center) / (2.0f * this->_dome_radius);
+            this->_pixel_lut[i] = glm::vec2(local.x + 0.5f, local.z + 0.5f);
+            this->_metrics.addSnap(0.0f);
         } else {
-            this->_second_hits.push_back(glm::vec3(1000, 1000, 1000));
+            this->_pixel_lut[i] = glm::vec2(-1.0f, -1.0f);
+            this->_metrics.addUnmapped();
         }
 
+        this->_texture_coords[i] = glm::vec3(this->_pixel_lut[i], 0.0f);
     }
 
+    // connect neighbouring pixels whose rays all reached the dome
+    std::vector<unsigned int> indices;
+    for (int row = 0; row < grid.rows - 1; ++row) {
+        for (int column = 0; column < grid.columns - 1; ++column) {
+            unsigned int a = (unsigned int) grid.index(row, column);
+            unsigned int b = (unsigned int) grid.index(row, column + 1);
+            unsigned int c = (unsigned int) grid.index(row + 1, column);
+            unsigned int d = (unsigned int) grid.index(row + 1, column + 1);
+
+            if (this->_ray_status[a] == DOME_HIT && this->_ray_status[b] == DOME_HIT &&
+                this->_ray_status[c] == DOME_HIT) {
+                unsigned int triangle[3] = {a, c, b};
+                indices.insert(indices.end(), triangle, triangle + 3);
+            }
+            if (this->_ray_status[b] == DOME_HIT && this->_ray_status[c] == DOME_HIT &&
+                this->_ray_status[d] == DOME_HIT) {
+                unsigned int triangle[3] = {b, c, d};
+                indices.insert(indices.end(), triangle, triangle + 3);
+            }
+        }
+    }
+
+    this->_mesh.setTriangles(indices, num_samples);
+    this->_mesh.setVertices(this->_screen_points, this->_texture_coords);
 }
 
 
-void DomeProjector::generateRadialGrid() {
+int DomeProjector::findNearestHit(glm::vec3 const &point, float *distance) {
+
+    float last_distance = std::numeric_limits<float>::max();
+    int last_hitpoint_idx = -1;
+
+    for (int hp_idx = 0; hp_idx < this->_second_hits.size(); ++hp_idx) {
 
-    // if there are elements in there kill'em
-    if (!this->_sample_grid.empty()) {
-        this->_sample_grid.clear();
+        // never snap to rays that got lost on their way
+        if (isMiss(this->_second_hits[hp_idx])) {
+            continue;
+        }
+
+        ++this->_metrics.num_distance_evaluations;
+        float current_distance = glm::length(this->_second_hits[hp_idx] - point);
+        if (current_distance < last_distance) {
+            last_distance = current_distance;
+            last_hitpoint_idx = hp_idx;
+        }
     }
 
-    float step_size =
-            ((this->_frustum->_near_clipping_corners[0].x - this->_frustum->_near_clipping_corners[1].x) / 2) /
-            _grid_rings;
+    *distance = last_distance;
+    return last_hitpoint_idx;
+}
 
-    // define center point
-    glm::vec3 center_point = glm::vec3(
-            (this->_frustum->_near_clipping_corners[1].x + this->_frustum->_near_clipping_corners[0].x) / 2,
-            (this->_frustum->_near_clipping_corners[1].y + this->_frustum->_near_clipping_corners[3].y) / 2,
-            this->_frustum->_near_clipping_corners[0].z);
+
+int DomeProjector::walkToNearestHit(glm::vec3 const &point, int seed_idx, float *distance) {
+
+    if (seed_idx < 0 || isMiss(this->_second_hits[seed_idx])) {
+        seed_idx = this->findCoarseSeed(point);
+        if (seed_idx < 0) {
+            *distance = std::numeric_limits<float>::max();
+            return -1;
+        }
+    }
+
+    bool settled;
+    int hit_idx = this->descend(point, seed_idx, distance, &settled);
+    if (!settled) {
+        ++this->_metrics.num_walk_fallbacks;
+    }
+
+    // the walk only compares grid neighbours and misses closer hits across folds or crowded rings,
+    // its distance is an upper bound though, so all hits within it contain the nearest one
+    glm::vec3 radius(*distance);
+    this->_hit_grid.query(point - radius, point + radius, &this->_neighbour_scratch);
+
+    for (int grid_idx : this->_neighbour_scratch) {
+        int candidate_idx = this->_hit_grid_indices[grid_idx];
+        ++this->_metrics.num_distance_evaluations;
+        float candidate_distance = glm::length(this->_second_hits[candidate_idx] - point);
+        if (candidate_distance < *distance) {
+            *distance = candidate_distance;
+            hit_idx = candidate_idx;
+        }
+    }
+
+    return hit_idx;
+}
+
+
+int DomeProjector::findCoarseSeed(glm::vec3 const &point) {
+
+    // scan a sparse subset of the grid for a good start
+    int stride = std::max(1, (int) std::sqrt((float) this->_second_hits.size()));
+    int seed_idx = -1;
+    float seed_distance = std::numeric_limits<float>::max();
+
+    for (int sample_idx = 0; sample_idx < this->_second_hits.size(); sample_idx += stride) {
+        if (isMiss(this->_second_hits[sample_idx])) {
+            continue;
+        }
+
+        ++this->_metrics.num_distance_evaluations;
+        float current_distance = glm::length(this->_second_hits[sample_idx] - point);
+        if (current_distance < seed_distance) {
+            seed_distance = current_distance;
+            seed_idx = sample_idx;
+        }
+    }
+
+    // every sampled ray got lost, try them all before giving up
+    if (seed_idx < 0) {
+        float distance;
+        seed_idx = this->findNearestHit(point, &distance);
+    }
+
+    return seed_idx;
+}
+
+
+void DomeProjector::buildHitGrid() {
+
+    std::vector<int> hit_indices;
+    std::vector<glm::vec3> hits;
+    for (int hp_idx = 0; hp_idx < this->_second_hits.size(); ++hp_idx) {
+        if (!isMiss(this->_second_hits[hp_idx])) {
+            hit_indices.push_back(hp_idx);
+            hits.push_back(this->_second_hits[hp_idx]);
+        }
+    }
+
+    this->_hit_grid.build(hits, hits, (int) std::cbrt((double) hits.size()));
+    this->_hit_grid_indices = hit_indices;
+}
+
+
+int DomeProjector::descend(glm::vec3 const &point, int seed_idx, float *distance, bool *settled) {
+
+    int current_idx = seed_idx;
+    float current_distance = glm::length(this->_second_hits[current_idx] - point);
+    ++this->_metrics.num_distance_evaluations;
+
+    // step to the closest neighbour until none of them gets closer
+    std::vector<int> &neighbours = this->_neighbour_scratch;
+    float reach = std::numeric_limits<float>::max();
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        reach = std::numeric_limits<float>::max();
+
+        this->sampleNeighbours(current_idx, &neighbours);
+        glm::vec3 const &current_hit = this->_second_hits[current_idx];
+        int best_idx = current_idx;
+        float best_distance = current_distance;
+
+        for (int neighbour_idx : neighbours) {
+            glm::vec3 const &hit = this->_second_hits[neighbour_idx];
+            if (isMiss(hit)) {
+                continue;
+            }
+
+            ++this->_metrics.num_distance_evaluations;
+            float neighbour_distance = glm::length(hit - point);
+            reach = std::min(reach, glm::length(hit - current_hit));
+            if (neighbour_distance < best_distance) {
+                best_distance = neighbour_distance;
+                best_idx = neighbour_idx;
+            }
+        }
+
+        if (best_idx != current_idx) {
+            current_idx = best_idx;
+            current_distance = best_distance;
+            improved = true;
+        }
+    }
+
+    // a point further away than the closest surrounding sample lies behind a hole, a fold or the grids border
+    *settled = reach != std::numeric_limits<float>::max() && current_distance <= reach;
+    *distance = current_distance;
+    return current_idx;
+}
+
+
+void DomeProjector::sampleNeighbours(int sample_idx, std::vector<int> *neighbours) const {
+
+    neighbours->clear();
+
+    // scattered samples have no neighbours, their walks resort to the hit grid
+    SampleGrid const &grid = this->_grid;
+    if (!grid.structured()) {
+        return;
+    }
+
+    // the center touches the whole first ring
+    if (grid.has_center && sample_idx == 0) {
+        for (int column = 0; column < grid.columns; ++column) {
+            neighbours->push_back(grid.index(0, column));
+        }
+        return;
+    }
+
+    int row = (sample_idx - grid.index(0, 0)) / grid.columns;
+    int column = (sample_idx - grid.index(0, 0)) % grid.columns;
+
+    for (int row_offset = -1; row_offset <= 1; ++row_offset) {
+        int neighbour_row = row + row_offset;
+        if (neighbour_row < 0 && grid.has_center) {
+            neighbours->push_back(0);
+            continue;
+        }
+        if (neighbour_row < 0 || neighbour_row >= grid.rows) {
+            continue;
+        }
+
+        for (int column_offset = -1; column_offset <= 1; ++column_offset) {
+            int neighbour_column = column + column_offset;
+            if (row_offset == 0 && column_offset == 0) {
+                continue;
+            }
+            if (grid.wraps) {
+                neighbour_column = (neighbour_column + grid.columns) % grid.columns;
+            } else if (neighbour_column < 0 || neighbour_column >= grid.columns) {
+                continue;
+            }
+            neighbours->push_back(grid.index(neighbour_row, neighbour_column));
+        }
+    }
+}
 
 
-    std::cout << utility::vecstr(center_point) << std::endl;
+void DomeProjector::buildSampleTriangles() {
+
+    this->_sample_triangles.clear();
+
+    // scattered samples have no topology to triangulate
+    SampleGrid const &grid = this->_grid;
+    std::vector<unsigned int> candidates;
+    if (!grid.structured()) {
+        this->_triangle_grid.build(std::vector<glm::vec3>(), std::vector<glm::vec3>(), 0);
+        return;
+    }
 
-    float angle = 360.0f / _grid_ring_elements;
+    // fan from the center to the first ring
+    if (grid.has_center) {
+        for (int column = 0; column < grid.columns; ++column) {
+            int next_column = (column + 1) % grid.columns;
+            unsigned int fan[3] = {0, (unsigned int) grid.index(0, column), (unsigned int) grid.index(0, next_column)};
+            candidates.insert(candidates.end(), fan, fan + 3);
+        }
+    }
 
-    this->_sample_grid.push_back(center_point);
-    for (unsigned int ring_idx = 1; ring_idx < _grid_rings + 1; ++ring_idx) {
-        for (unsigned int ring_point_idx = 0; ring_point_idx < _grid_ring_elements; ++ring_point_idx) {
-            glm::quat euler_quat(glm::vec3(0.0, 0.0, glm::radians(angle * ring_point_idx)));
-            glm::vec3 coord = euler_quat * glm::vec3(ring_idx * step_size, 0.0, 0.0);
+    // two triangles between each pair of neighbouring rows
+    int num_quads = grid.wraps ? grid.columns : grid.columns - 1;
+    for (int row = 0; row < grid.rows - 1; ++row) {
+        for (int column = 0; column < num_quads; ++column) {
+            int next_column = (column + 1) % grid.columns;
+            unsigned int a = (unsigned int) grid.index(row, column);
+            unsigned int b = (unsigned int) grid.index(row, next_column);
+            unsigned int c = (unsigned int) grid.index(row + 1, column);
+            unsigned int d = (unsigned int) grid.index(row + 1, next_column);
+            unsigned int quad[6] = {a, c, b, b, c, d};
+            candidates.insert(candidates.end(), quad, quad + 6);
+        }
+    }
 
-            // push back the rotated point at the near clipping plaes z position
-            this->_sample_grid.emplace_back(glm::vec3(coord.x, coord.y, this->_frustum->_near_clipping_corners[0].z));
+    // keep triangles whose rays all made it into the dome
+    std::vector<float> longest_edges;
+    for (unsigned long i = 0; i < candidates.size(); i += 3) {
+        glm::vec3 const &a = this->_second_hits[candidates[i]];
+        glm::vec3 const &b = this->_second_hits[candidates[i + 1]];
+        glm::vec3 const &c = this->_second_hits[candidates[i + 2]];
+        if (isMiss(a) || isMiss(b) || isMiss(c)) {
+            continue;
         }
+
+        longest_edges.push_back(std::max(glm::length(b - a), std::max(glm::length(c - b), glm::length(a - c))));
+        this->_sample_triangles.insert(this->_sample_triangles.end(), &candidates[i], &candidates[i] + 3);
     }
 
+    if (longest_edges.empty()) {
+        this->_triangle_grid.build(std::vector<glm::vec3>(), std::vector<glm::vec3>(), 0);
+        return;
+    }
+
+    // neighbouring rays may split at the mirrors rim and span large parts of the dome
+    std::vector<float> sorted_edges(longest_edges);
+    std::nth_element(sorted_edges.begin(), sorted_edges.begin() + sorted_edges.size() / 2, sorted_edges.end());
+    float max_edge = MAX_EDGE_FACTOR * sorted_edges[sorted_edges.size() / 2];
+
+    std::vector<unsigned int> triangles;
+    std::vector<glm::vec3> box_min;
+    std::vector<glm::vec3> box_max;
+    for (unsigned long tri_idx = 0; tri_idx < longest_edges.size(); ++tri_idx) {
+        if (longest_edges[tri_idx] > max_edge) {
+            continue;
+        }
+
+        glm::vec3 const &a = this->_second_hits[this->_sample_triangles[tri_idx * 3]];
+        glm::vec3 const &b = this->_second_hits[this->_sample_triangles[tri_idx * 3 + 1]];
+        glm::vec3 const &c = this->_second_hits[this->_sample_triangles[tri_idx * 3 + 2]];
+
+        // grow the box by the edge length to cover the bulge of the dome above the triangle
+        glm::vec3 bulge(longest_edges[tri_idx]);
+        box_min.push_back(glm::min(a, glm::min(b, c)) - bulge);
+        box_max.push_back(glm::max(a, glm::max(b, c)) + bulge);
+        triangles.insert(triangles.end(), &this->_sample_triangles[tri_idx * 3], &this->_sample_triangles[tri_idx * 3] + 3);
+    }
+
+    this->_sample_triangles = triangles;
+    this->_triangle_grid.build(box_min, box_max, (int) std::cbrt((double) box_min.size()));
+}
+
+
+bool DomeProjector::findSampleTriangle(glm::vec3 const &point, unsigned int const **corners, glm::vec3 *weights,
+                                       float *distance) const {
+
+    int const *begin;
+    int const *end;
+    this->_triangle_grid.query(point, &begin, &end);
+
+    float best_distance = std::numeric_limits<float>::max();
+    for (int const *it = begin; it != end; ++it) {
+        unsigned int const *tri = &this->_sample_triangles[*it * 3];
+        glm::vec3 const &a = this->_second_hits[tri[0]];
+        glm::vec3 edge_ab = this->_second_hits[tri[1]] - a;
+        glm::vec3 edge_ac = this->_second_hits[tri[2]] - a;
+        glm::vec3 normal = glm::cross(edge_ab, edge_ac);
+
+        float normal_sqr = glm::dot(normal, normal);
+        if (normal_sqr == 0.0f) {
+            continue;
+        }
+
+        // barycentric coordinates of the point projected onto the triangle plane
+        glm::vec3 to_point = point - a;
+        float v = glm::dot(glm::cross(to_point, edge_ac), normal) / normal_sqr;
+        float w = glm::dot(glm::cross(edge_ab, to_point), normal) / normal_sqr;
+        float u = 1.0f - v - w;
+        if (u < -BARYCENTRIC_EPSILON || v < -BARYCENTRIC_EPSILON || w < -BARYCENTRIC_EPSILON) {
+            continue;
+        }
+
+        float plane_distance = std::abs(glm::dot(to_point, normal)) / std::sqrt(normal_sqr);
+        if (plane_distance < best_distance) {
+            best_distance = plane_distance;
+            *corners = tri;
+            *weights = glm::vec3(u, v, w);
+        }
+    }
+
+    *distance = best_distance;
+    return best_distance != std::numeric_limits<float>::max();
+}
+
+
+void DomeProjector::calculateBrightness() {
+
+    unsigned long num_samples = this->_second_hits.size();
+    this->_brightness.resize(num_samples);
+
+    parallel::forTiles(0, (long) num_samples, RAY_TILE_SIZE, [&](long begin, long end) {
+        std::vector<int> neighbours;
+        for (long i = begin; i < end; ++i) {
+            BrightnessSample &sample = this->_brightness[i];
+            sample.footprint = 0.0f;
+            sample.cos_incidence = 0.0f;
+            sample.path_length = 0.0f;
+            sample.gain = 1.0f;
+            if (this->_ray_status[i] != DOME_HIT) {
+                continue;
+            }
+
+            // the dome faces its center, the light arrives along the reflected ray
+            glm::vec3 path = this->_second_hits[i] - this->_first_hits[i];
+            glm::vec3 normal = glm::normalize(this->_dome_center - this->_second_hits[i]);
+            sample.path_length = glm::length(path);
+            sample.cos_incidence = std::abs(glm::dot(path, normal)) / sample.path_length;
+            sample.footprint = this->sampleFootprint((int) i, &neighbours);
+        }
+    });
+
+    std::vector<float> footprints;
+    footprints.reserve(num_samples);
+    for (auto const &sample : this->_brightness) {
+        if (sample.footprint > 0.0f) {
+            footprints.push_back(sample.footprint);
+        }
+    }
+    if (footprints.empty()) {
+        return;
+    }
+
+    // the irradiance falls with the footprint, so the largest footprint is the dimmest spot
+    auto reference = footprints.begin() + (long) ((footprints.size() - 1) * BRIGHTNESS_REFERENCE_PERCENTILE);
+    std::nth_element(footprints.begin(), reference, footprints.end());
+    float reference_footprint = *reference;
+
+    for (auto &sample : this->_brightness) {
+        if (sample.footprint > 0.0f) {
+            sample.gain = std::min(sample.footprint / reference_footprint, 1.0f);
+        }
+    }
+}
+
+
+float DomeProjector::sampleFootprint(int sample_idx, std::vector<int> *neighbours) const {
+
+    this->sampleNeighbours(sample_idx, neighbours);
+
+    // least squares fit of dome offsets = jacobian * grid offsets over all hitting neighbours
+    SampleGrid const &grid = this->_grid;
+    glm::vec3 const &hit = this->_second_hits[sample_idx];
+    float grid_xx = 0.0f, grid_xy = 0.0f, grid_yy = 0.0f;
+    glm::vec3 dome_x(0.0f), dome_y(0.0f);
+    for (int neighbour_idx : *neighbours) {
+        if (this->_ray_status[neighbour_idx] != DOME_HIT) {
+            continue;
+        }
+        float dx = grid.x[neighbour_idx] - grid.x[sample_idx];
+        float dy = grid.y[neighbour_idx] - grid.y[sample_idx];
+        glm::vec3 offset = this->_second_hits[neighbour_idx] - hit;
+
+        grid_xx += dx * dx;
+        grid_xy += dx * dy;
+        grid_yy += dy * dy;
+        dome_x += offset * dx;
+        dome_y += offset * dy;
+    }
+
+    float determinant = grid_xx * grid_yy - grid_xy * grid_xy;
+    if (determinant <= std::numeric_limits<float>::epsilon() * grid_xx * grid_yy) {
+        return 0.0f;
+    }
+
+    // columns of the jacobian are the dome directions of a step along x and y
+    glm::vec3 along_x = (dome_x * grid_yy - dome_y * grid_xy) / determinant;
+    glm::vec3 along_y = (dome_y * grid_xx - dome_x * grid_xy) / determinant;
+    return glm::length(glm::cross(along_x, along_y));
+}
+
+
+void DomeProjector::countRingHit(glm::vec3 const &hit, Sphere *dome) {
+
+    // polar angle of the hit measured from the domes zenith
+    glm::vec3 local = glm::normalize(hit - dome->get_position());
+    float phi = std::acos(glm::clamp(local.y, -1.0f, 1.0f));
+
+    unsigned long num_rings = this->_metrics.ring_hits.size();
+    unsigned long ring_idx = (unsigned long) (phi / glm::radians(90.0f) * num_rings);
+    ++this->_metrics.ring_hits[std::min(ring_idx, num_rings - 1)];
+}
+
+
+bool DomeProjector::isMiss(glm::vec3 const &hit) {
+    return hit == MISS_POSITION;
+}
+
+
+void DomeProjector::generateSampleGrid() {
+
+    ++this->_generation;
+
+    std::vector<glm::vec3> const &corners = this->_frustum->_near_clipping_corners;
+    float half_width = std::abs(corners[0].x - corners[1].x) / 2;
+    float half_height = std::abs(corners[1].y - corners[2].y) / 2;
+
+    this->_grid_generator.generate(half_width, half_height, &this->_grid);
+
+    // span the plane samples between the near clipping corners in world space
+    glm::vec3 right = corners[1] - corners[0];
+    glm::vec3 down = corners[3] - corners[0];
+    this->_sample_grid.resize(this->_grid.size());
+    for (unsigned long i = 0; i < this->_grid.size(); ++i) {
+        float u = 0.5f + this->_grid.x[i] / (2.0f * half_width);
+        float v = 0.5f - this->_grid.y[i] / (2.0f * half_height);
+        this->_sample_grid[i] = corners[0] + u * right + v * down;
+    }
 }
 
 void DomeProjector::generateDomeVertices() {
+
+    ++this->_generation;
+
+    if (this->_dome_tessellation == GEODESIC) {
+        this->generateGeodesicVertices();
+    } else {
+        this->generateLatLongVertices();
+    }
+
+    this->_dome_unit_vertices = this->_dome_vertices;
+
+    // until the dome is known the vertices sit on a sphere of the default dome radius
+    glm::mat4 scale_mat(1.0f);
+    scale_mat = glm::scale(scale_mat, glm::vec3(1.6f, 1.6f, 1.6f));
+
+    for (int j = 0; j < this->_dome_vertices.size(); ++j) {
+        glm::vec4 res = scale_mat * glm::vec4(this->_dome_vertices[j], 1.0f);
+        this->_dome_vertices[j] = glm::vec3(res);
+    }
+}
+
+
+void DomeProjector::generateLatLongVertices() {
     /*
      * THETA - AROUND Y
      * PHI - X AND
@@ -258,17 +965,136 @@ void DomeProjector::generateDomeVertices() {
     }
 
     this->_dome_vertices = vertices;
+
+    // fan around the pole cap
+    std::vector<unsigned int> &indices = this->_dome_indices;
+    indices.clear();
+    for (int segment_idx = 0; segment_idx < this->_dome_ring_elements; ++segment_idx) {
+        int next_idx = (segment_idx + 1) % this->_dome_ring_elements;
+        unsigned int fan[3] = {0, (unsigned int) (1 + segment_idx), (unsigned int) (1 + next_idx)};
+        indices.insert(indices.end(), fan, fan + 3);
+    }
+
+    // two triangles per ring segment, the last segment closes the seam by wrapping around
+    for (int ring_idx = 0; ring_idx < this->_dome_rings - 1; ++ring_idx) {
+        unsigned int upper = (unsigned int) (1 + ring_idx * this->_dome_ring_elements);
+        unsigned int lower = upper + this->_dome_ring_elements;
+
+        for (int segment_idx = 0; segment_idx < this->_dome_ring_elements; ++segment_idx) {
+            unsigned int next_idx = (unsigned int) ((segment_idx + 1) % this->_dome_ring_elements);
+            unsigned int quad[6] = {upper + segment_idx, lower + segment_idx, upper + next_idx,
+                                    upper + next_idx, lower + segment_idx, lower + next_idx};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+
+void DomeProjector::generateGeodesicVertices() {
+
+    // icosahedron standing on one of its vertices, its second ring is turned by half a segment
+    float ring_y = 1.0f / std::sqrt(5.0f);
+    float ring_radius = 2.0f / std::sqrt(5.0f);
+
+    std::vector<glm::vec3> vertices;
+    vertices.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+    for (int i = 0; i < 5; ++i) {
+        float theta = glm::radians(72.0f * i);
+        vertices.push_back(glm::vec3(ring_radius * std::sin(theta), ring_y, ring_radius * std::cos(theta)));
+    }
+    for (int i = 0; i < 5; ++i) {
+        float theta = glm::radians(72.0f * i + 36.0f);
+        vertices.push_back(glm::vec3(ring_radius * std::sin(theta), -ring_y, ring_radius * std::cos(theta)));
+    }
+    vertices.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
+
+    std::vector<unsigned int> indices;
+    for (unsigned int i = 0; i < 5; ++i) {
+        unsigned int upper = 1 + i;
+        unsigned int upper_next = 1 + (i + 1) % 5;
+        unsigned int lower = 6 + i;
+        unsigned int lower_next = 6 + (i + 1) % 5;
+        unsigned int faces[12] = {0, upper, upper_next,
+                                  upper, lower, upper_next,
+                                  upper_next, lower, lower_next,
+                                  lower, 11, lower_next};
+        indices.insert(indices.end(), faces, faces + 12);
+    }
+
+    // split every triangle into four, neighbouring triangles share their edge midpoints
+    for (int level = 0; level < this->_dome_subdivisions; ++level) {
+        std::map<std::pair<unsigned int, unsigned int>, unsigned int> midpoints;
+        auto midpoint = [&](unsigned int a, unsigned int b) {
+            std::pair<unsigned int, unsigned int> edge(std::min(a, b), std::max(a, b));
+            auto found = midpoints.find(edge);
+            if (found != midpoints.end()) {
+                return found->second;
+            }
+            unsigned int idx = (unsigned int) vertices.size();
+            vertices.push_back(glm::normalize(vertices[a] + vertices[b]));
+            midpoints[edge] = idx;
+            return idx;
+        };
+
+        std::vector<unsigned int> subdivided;
+        subdivided.reserve(indices.size() * 4);
+        for (unsigned long i = 0; i < indices.size(); i += 3) {
+            unsigned int a = indices[i];
+            unsigned int b = indices[i + 1];
+            unsigned int c = indices[i + 2];
+            unsigned int ab = midpoint(a, b);
+            unsigned int bc = midpoint(b, c);
+            unsigned int ca = midpoint(c, a);
+            unsigned int faces[12] = {a, ab, ca,
+                                      ab, b, bc,
+                                      ca, bc, c,
+                                      ab, bc, ca};
+            subdivided.insert(subdivided.end(), faces, faces + 12);
+        }
+        indices.swap(subdivided);
+    }
+
+    // the midpoints of the band between both rings form the equator from the first subdivision on,
+    // so every triangle lies entirely above or below it
+    const float equator_epsilon = 0.0001f;
+    std::vector<int> remap(vertices.size(), -1);
+    this->_dome_vertices.clear();
+    for (unsigned long i = 0; i < vertices.size(); ++i) {
+        if (vertices[i].y >= -equator_epsilon) {
+            remap[i] = (int) this->_dome_vertices.size();
+            this->_dome_vertices.push_back(vertices[i]);
+        }
+    }
+
+    this->_dome_indices.clear();
+    for (unsigned long i = 0; i < indices.size(); i += 3) {
+        if (remap[indices[i]] < 0 || remap[indices[i + 1]] < 0 || remap[indices[i + 2]] < 0) {
+            continue;
+        }
+        for (int corner = 0; corner < 3; ++corner) {
+            this->_dome_indices.push_back((unsigned int) remap[indices[i + corner]]);
+        }
+    }
 }
 
 void DomeProjector::saveTransformations() const {
 
-    std::vector<glm::vec3> screen_cpy(this->_screen_points);
+    // pixel aligned meshes are laid out in the rows and columns of the sample grid,
+    // geodesic domes have no rows and columns at all and rely on the mesh indices
+    bool pixel_aligned = this->_grid_generator.get_layout() == GridGenerator::PIXEL;
+    int mesh_rows = pixel_aligned ? this->_grid.rows : this->_dome_rings;
+    int mesh_columns = pixel_aligned ? this->_grid.columns : this->_dome_ring_elements;
+    if (!pixel_aligned && this->_dome_tessellation == GEODESIC) {
+        mesh_rows = 0;
+        mesh_columns = 0;
+    }
+
     std::stringstream oss;
-    for (auto point: screen_cpy) {
+    for (auto const &point : this->_screen_points) {
         oss << point.x << " " << point.y << " " << point.z << std::endl;
     }
 
-    oss << this->_dome_rings << " " << this->_dome_ring_elements << " " << this->_screen_points.size() << std::endl;
+    oss << mesh_rows << " " << mesh_columns << " " << this->_screen_points.size() << std::endl;
 
     std::ofstream out_stream;
     out_stream.open("../../glwarp/new_screen_points.txt");
@@ -278,18 +1104,76 @@ void DomeProjector::saveTransformations() const {
     // clear the stringstream by filling it with an empty string
     oss.str(std::string());
 
-    std::vector<glm::vec3> texture_cpy(this->_texture_coords);
-    for (auto point: texture_cpy) {
+    for (auto const &point : this->_texture_coords) {
         oss << point.x << " " << point.y << " " << point.z << std::endl;
     }
 
-    oss << this->_dome_rings << " " << this->_dome_ring_elements << " " << this->_screen_points.size() << std::endl;
+    oss << mesh_rows << " " << mesh_columns << " " << this->_screen_points.size() << std::endl;
 
     out_stream.open("../../glwarp/new_texture_coords.txt");
     out_stream << oss.str();
     out_stream.close();
 
-    std::cout << "successfully saved texture and screen coords in 'out/'" << std::endl;
+    // triangle count followed by one index triple per line
+    oss.str(std::string());
+    unsigned long num_indices = this->_mesh.numIndices();
+    oss << num_indices / 3 << std::endl;
+    for (unsigned long i = 0; i < num_indices; i += 3) {
+        oss << this->_mesh.index(i) << " " << this->_mesh.index(i + 1) << " " << this->_mesh.index(i + 2) << std::endl;
+    }
+
+    out_stream.open("../../glwarp/new_mesh_indices.txt");
+    out_stream << oss.str();
+    out_stream.close();
+
+    // one brightness gain per mesh vertex, the player multiplies its pixels by the interpolated gain
+    oss.str(std::string());
+    for (float gain : this->_vertex_gains) {
+        oss << gain << std::endl;
+    }
+
+    oss << mesh_rows << " " << mesh_columns << " " << this->_vertex_gains.size() << std::endl;
+
+    out_stream.open("../../glwarp/new_brightness.txt");
+    out_stream << oss.str();
+    out_stream.close();
+
+    std::cout << "successfully saved texture and screen coords, mesh indices and brightness in 'out/'" << std::endl;
+}
+
+void DomeProjector::exportGeometry(std::string const &directory) const {
+
+    // lost rays would stretch the bounds of every viewer, so they are left out
+    std::vector<glm::vec3> first_hits;
+    std::vector<glm::vec3> second_hits;
+    first_hits.reserve(this->_first_hits.size());
+    second_hits.reserve(this->_second_hits.size());
+    for (unsigned long i = 0; i < this->_second_hits.size(); ++i) {
+        if (!isMiss(this->_first_hits[i])) {
+            first_hits.push_back(this->_first_hits[i]);
+        }
+        if (!isMiss(this->_second_hits[i])) {
+            second_hits.push_back(this->_second_hits[i]);
+        }
+    }
+
+    std::vector<exporter::PointSet> point_sets;
+    point_sets.emplace_back("sample_grid", this->_sample_grid);
+    point_sets.emplace_back("first_hits", first_hits);
+    point_sets.emplace_back("second_hits", second_hits);
+    point_sets.emplace_back("dome_vertices", this->_dome_vertices);
+
+    bool success = exporter::writeMeshPly(directory + "warp_mesh.ply", this->_mesh);
+    for (auto const &point_set : point_sets) {
+        success &= exporter::writePointsPly(directory + point_set.name + ".ply", *point_set.points);
+    }
+    success &= exporter::writeGlb(directory + "scene.glb", this->_mesh, point_sets);
+
+    if (success) {
+        std::cout << "successfully exported warp mesh and point sets to '" << directory << "'" << std::endl;
+    } else {
+        std::cout << "failed to export warp mesh and point sets to '" << directory << "'" << std::endl;
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -297,51 +1181,193 @@ void DomeProjector::saveTransformations() const {
 // ---------------------------------------------------------------------------
 
 /**
- * Returns a std::vec containing the radial sample grid.
+ * Returns the projectors resolution.
+ * @return
+ */
+Screen const &DomeProjector::get_screen() const {
+    return *this->_screen;
+}
+
+/**
+ * Returns the projectors world position.
+ * @return
+ */
+glm::vec3 DomeProjector::get_position() const {
+    return this->_position;
+}
+
+/**
+ * Returns the number of times the results got rewritten, views of an older generation are stale.
+ * @return
+ */
+unsigned long DomeProjector::get_generation() const {
+    return this->_generation;
+}
+
+/**
+ * Returns a view of the sample grid on the near plane.
+ * @return
+ */
+ResultView<glm::vec3> DomeProjector::get_sample_grid() const {
+    return ResultView<glm::vec3>(this->_sample_grid, this->_generation);
+}
+
+/**
+ * Returns a view of all first hitpoints supposed to be on the mirrors surface.
+ * @return
+ */
+ResultView<glm::vec3> DomeProjector::get_first_hits() const {
+    return ResultView<glm::vec3>(this->_first_hits, this->_generation);
+}
+
+/**
+ * Returns a view of all second hitpoints supposed to be within the dome.
+ * @return
+ */
+ResultView<glm::vec3> DomeProjector::get_second_hits() const {
+    return ResultView<glm::vec3>(this->_second_hits, this->_generation);
+}
+
+/**
+ * Returns a view of the vertices of the half sphere.
+ * @return
+ */
+ResultView<glm::vec3> DomeProjector::get_dome_vertices() const {
+    return ResultView<glm::vec3>(this->_dome_vertices, this->_generation);
+}
+
+/**
+ * Returns the triangles connecting the dome vertices.
  * @return
  */
-std::vector<glm::vec3> const &DomeProjector::get_sample_grid() const {
-    return this->_sample_grid;
+std::vector<unsigned int> const &DomeProjector::get_dome_indices() const {
+    return this->_dome_indices;
 }
 
 /**
- * Returns a std::vector containing all first hitpoints supposed to be on the mirrors surface.
+ * Returns a view of the screen points of the final warping mesh
  * @return
  */
-std::vector<glm::vec3> const &DomeProjector::get_first_hits() const {
-    return this->_first_hits;
+ResultView<glm::vec3> DomeProjector::get_screen_points() const {
+    return ResultView<glm::vec3>(this->_screen_points, this->_generation);
 }
 
 /**
- * Returns a std::vector containing all second hitpoints supposed to be within the dome.
+ * Returns a view of the texture coordinates of the final warping mesh
  * @return
  */
-std::vector<glm::vec3> const &DomeProjector::get_second_hits() const {
-    return this->_second_hits;
+ResultView<glm::vec3> DomeProjector::get_texture_coords() const {
+    return ResultView<glm::vec3>(this->_texture_coords, this->_generation);
 }
 
 /**
- * Returns a std::vector containing the vertices for a half sphere.
+ * Returns the indexed warp mesh built from screen points and texture coordinates.
  * @return
  */
-std::vector<glm::vec3> const &DomeProjector::get_dome_vertices() const {
-    return this->_dome_vertices;
+DomeMesh const &DomeProjector::get_mesh() const {
+    return this->_mesh;
 }
 
 /**
- * Returns a std::vector containing vertices of the final warping mesh
+ * Returns the texture coordinate of each pixel sample, (-1, -1) for pixels not reaching the dome.
+ * Only filled for the pixel aligned layout, indexed by row * columns + column.
  * @return
  */
-std::vector<glm::vec3> const &DomeProjector::get_screen_points() const {
-    return this->_screen_points;
+std::vector<glm::vec2> const &DomeProjector::get_pixel_lut() const {
+    return this->_pixel_lut;
 }
 
 /**
- * Returns a std::vector containing vertices of the final warping mesh
+ * Returns the brightness estimate of each sample, indexed like the sample grid.
  * @return
  */
-std::vector<glm::vec3> const &DomeProjector::get_texture_coords() const {
-    return this->_texture_coords;
+std::vector<DomeProjector::BrightnessSample> const &DomeProjector::get_brightness() const {
+    return this->_brightness;
+}
+
+/**
+ * Returns the brightness gain of each warp mesh vertex.
+ * @return
+ */
+std::vector<float> const &DomeProjector::get_vertex_gains() const {
+    return this->_vertex_gains;
+}
+
+
+/**
+ * Returns the sample each dome vertex got mapped to, -1 for unmapped vertices.
+ * @return
+ */
+std::vector<int> const &DomeProjector::get_vertex_samples() const {
+    return this->_vertex_samples;
+}
+
+/**
+ * Returns the dome footprint of each sample's pixel, empty unless ray differentials are enabled.
+ * @return
+ */
+std::vector<DomeProjector::FootprintEllipse> const &DomeProjector::get_footprint_ellipses() const {
+    return this->_footprint_ellipses;
+}
+
+/**
+ * Returns the quality metrics of the last raycast and mapping run.
+ * @return
+ */
+MappingMetrics const &DomeProjector::get_metrics() const {
+    return this->_metrics;
+}
+
+// ---------------------------------------------------------------------------
+// SETTER
+// ---------------------------------------------------------------------------
+
+/**
+ * Sets the distance up to which a snapped dome vertex counts as covered.
+ * @param tolerance
+ */
+void DomeProjector::set_snap_tolerance(float tolerance) {
+    this->_snap_tolerance = tolerance;
+}
+
+/**
+ * Sets how dome vertices are mapped onto the projectors sample grid.
+ * @param mode
+ */
+void DomeProjector::set_mapping_mode(MappingMode mode) {
+    this->_mapping_mode = mode;
+}
+
+/**
+ * Replaces the projectors frustum and regenerates the sample grid on its near plane.
+ * @param frustum taken over by the dome projector
+ */
+void DomeProjector::set_frustum(Frustum *frustum) {
+    if (frustum != this->_frustum) {
+        delete this->_frustum;
+        this->_frustum = frustum;
+    }
+    this->generateSampleGrid();
+}
+
+/**
+ * Carries ray differentials along every ray to measure the pixel footprints on the dome.
+ * Takes effect with the next raycast.
+ * @param enabled
+ */
+void DomeProjector::set_ray_differentials(bool enabled) {
+    this->_ray_differentials = enabled;
+}
+
+/**
+ * Switches the tessellation of the dome and regenerates its vertices.
+ * @param tessellation
+ * @param subdivisions number of times the icosahedron gets subdivided, at least one
+ */
+void DomeProjector::set_dome_tessellation(DomeTessellation tessellation, int subdivisions) {
+    this->_dome_tessellation = tessellation;
+    this->_dome_subdivisions = std::max(subdivisions, 1);
+    this->generateDomeVertices();
 }
 
 /**
@@ -355,8 +1381,8 @@ std::ostream &operator<<(std::ostream &os, const DomeProjector &projector) {
        << "  screen: <width: " << projector._screen->width << " height: " << projector._screen->height << ">\n"
        << "  position: [" << projector._position.x << ", " << projector._position.y << ", " << projector._position.z
        << "]\n"
-       << "  grid_rings: " << projector._grid_rings << "\n"
-       << "  grid_ring_elements: " << projector._grid_ring_elements << "\n"
+       << "  grid: <layout: " << projector._grid_generator.get_layout()
+       << " rows: " << projector._grid.rows << " columns: " << projector._grid.columns << ">\n"
        << "  sample_grid: " << projector._sample_grid.size() << "\n"
        << "  first_hits: " << projector._first_hits.size() << "\n"
        << "  second_hits: " << projector._second_hits.size();
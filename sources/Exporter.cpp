@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <limits>
+
+#include <lib/json11.hpp>
+
+#include "Exporter.hpp"
+
+// glb chunk and component types as defined by the glTF 2.0 specification
+#define GLB_MAGIC 0x46546C67u
+#define GLB_VERSION 2u
+#define GLB_CHUNK_JSON 0x4E4F534Au
+#define GLB_CHUNK_BIN 0x004E4942u
+#define GL_TYPE_UNSIGNED_SHORT 5123
+#define GL_TYPE_UNSIGNED_INT 5125
+#define GL_TYPE_FLOAT 5126
+#define GL_TARGET_ARRAY_BUFFER 34962
+#define GL_TARGET_ELEMENT_ARRAY_BUFFER 34963
+#define GLTF_MODE_POINTS 0
+#define GLTF_MODE_TRIANGLES 4
+
+// point sets go into the files as they lie in memory
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be three tightly packed floats");
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "glm::vec2 must be two tightly packed floats");
+
+namespace exporter {
+
+    /**
+     * Appends the raw bytes of a value range to the buffer
+     * @param buffer
+     * @param data
+     * @param num_bytes
+     */
+    static void append(std::vector<char> *buffer, void const *data, unsigned long num_bytes) {
+        if (num_bytes == 0) {
+            return;
+        }
+        unsigned long offset = buffer->size();
+        buffer->resize(offset + num_bytes);
+        std::memcpy(buffer->data() + offset, data, num_bytes);
+    }
+
+    /**
+     * Appends the given text without its terminating zero
+     * @param buffer
+     * @param text
+     */
+    static void append(std::vector<char> *buffer, std::string const &text) {
+        append(buffer, text.data(), text.size());
+    }
+
+    /**
+     * Pads the buffer with the given byte up to the next multiple of four
+     * @param buffer
+     * @param padding
+     */
+    static void align4(std::vector<char> *buffer, char padding) {
+        while (buffer->size() % 4 != 0) {
+            buffer->push_back(padding);
+        }
+    }
+
+    /**
+     * Writes the buffer to disk in one go
+     * @param path
+     * @param buffer
+     * @return
+     */
+    static bool writeFile(std::string const &path, std::vector<char> const &buffer) {
+        std::ofstream out_stream(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out_stream) {
+            return false;
+        }
+        out_stream.write(buffer.data(), buffer.size());
+        return (bool) out_stream;
+    }
+
+    /**
+     * Checks whether this machine stores the lowest byte first
+     * @return
+     */
+    static bool isLittleEndian() {
+        unsigned int probe = 1;
+        unsigned char first_byte;
+        std::memcpy(&first_byte, &probe, 1);
+        return first_byte == 1;
+    }
+
+    /**
+     * Turns host ordered components into little endian ones, glb allows no other byte order
+     * @param data
+     * @param num_bytes
+     * @param component_bytes
+     */
+    static void toLittleEndian(char *data, unsigned long num_bytes, unsigned long component_bytes) {
+        if (isLittleEndian()) {
+            return;
+        }
+        for (unsigned long offset = 0; offset + component_bytes <= num_bytes; offset += component_bytes) {
+            std::reverse(data + offset, data + offset + component_bytes);
+        }
+    }
+
+    /**
+     * PLY format name matching the byte order of this machine
+     * @return
+     */
+    static char const *plyFormat() {
+        return isLittleEndian() ? "binary_little_endian" : "binary_big_endian";
+    }
+
+
+    bool writePointsPly(std::string const &path, std::vector<glm::vec3> const &points) {
+
+        std::ostringstream header;
+        header << "ply\n"
+               << "format " << plyFormat() << " 1.0\n"
+               << "element vertex " << points.size() << "\n"
+               << "property float x\n"
+               << "property float y\n"
+               << "property float z\n"
+               << "end_header\n";
+
+        std::vector<char> buffer;
+        buffer.reserve(header.str().size() + points.size() * sizeof(glm::vec3));
+        append(&buffer, header.str());
+        append(&buffer, points.data(), points.size() * sizeof(glm::vec3));
+
+        return writeFile(path, buffer);
+    }
+
+
+    bool writeMeshPly(std::string const &path, DomeMesh const &mesh) {
+
+        unsigned long num_vertices = mesh.numVertices();
+        unsigned long num_triangles = mesh.numIndices() / 3;
+
+        std::ostringstream header;
+        header << "ply\n"
+               << "format " << plyFormat() << " 1.0\n"
+               << "element vertex " << num_vertices << "\n"
+               << "property float x\n"
+               << "property float y\n"
+               << "property float z\n"
+               << "property float s\n"
+               << "property float t\n"
+               << "element face " << num_triangles << "\n"
+               << "property list uchar uint vertex_indices\n"
+               << "end_header\n";
+
+        // viewers expect a z coordinate, the screen plane lies at 0
+        unsigned long vertex_bytes = (DomeMesh::FLOATS_PER_VERTEX + 1) * sizeof(float);
+
+        // faces are stored as a count followed by their indices
+        unsigned long face_bytes = sizeof(unsigned char) + 3 * sizeof(unsigned int);
+
+        std::vector<char> buffer;
+        buffer.reserve(header.str().size() + num_vertices * vertex_bytes + num_triangles * face_bytes);
+        append(&buffer, header.str());
+
+        unsigned long offset = buffer.size();
+        buffer.resize(offset + num_vertices * vertex_bytes);
+        char *vertex = buffer.data() + offset;
+        for (unsigned long i = 0; i < num_vertices; ++i) {
+            float const *source = &mesh.vertices[i * DomeMesh::FLOATS_PER_VERTEX];
+            float values[5] = {source[0], source[1], 0.0f, source[2], source[3]};
+            std::memcpy(vertex, values, sizeof(values));
+            vertex += vertex_bytes;
+        }
+
+        offset = buffer.size();
+        buffer.resize(offset + num_triangles * face_bytes);
+        char *face = buffer.data() + offset;
+        for (unsigned long i = 0; i < num_triangles; ++i) {
+            unsigned int triangle[3] = {mesh.index(3 * i), mesh.index(3 * i + 1), mesh.index(3 * i + 2)};
+            face[0] = 3;
+            std::memcpy(face + 1, triangle, sizeof(triangle));
+            face += face_bytes;
+        }
+
+        return writeFile(path, buffer);
+    }
+
+
+    /**
+     * Adds a buffer view and an accessor for the given data to the glb under construction
+     * @param binary binary chunk the data gets appended to
+     * @param buffer_views
+     * @param accessors
+     * @param data
+     * @param num_bytes
+     * @param count number of elements
+     * @param component_type
+     * @param type
+     * @param target
+     * @return index of the accessor
+     */
+    static int addAccessor(std::vector<char> *binary,
+                           json11::Json::array *buffer_views,
+                           json11::Json::array *accessors,
+                           void const *data,
+                           unsigned long num_bytes,
+                           unsigned long count,
+                           int component_type,
+                           std::string const &type,
+                           int target) {
+
+        // every view starts four byte aligned, which suits all component types
+        align4(binary, 0);
+        buffer_views->push_back(json11::Json::object{
+                {"buffer",     0},
+                {"byteOffset", (double) binary->size()},
+                {"byteLength", (double) num_bytes},
+                {"target",     target}
+        });
+        unsigned long offset = binary->size();
+        append(binary, data, num_bytes);
+        toLittleEndian(binary->data() + offset, num_bytes,
+                       component_type == GL_TYPE_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(float));
+
+        accessors->push_back(json11::Json::object{
+                {"bufferView",    (int) buffer_views->size() - 1},
+                {"componentType", component_type},
+                {"count",         (double) count},
+                {"type",          type}
+        });
+        return (int) accessors->size() - 1;
+    }
+
+    /**
+     * Adds the bounding box of the given positions to an accessor, as required for POSITION attributes
+     * @param accessors
+     * @param accessor_idx
+     * @param points
+     */
+    static void addBounds(json11::Json::array *accessors, int accessor_idx, std::vector<glm::vec3> const &points) {
+
+        glm::vec3 box_min(std::numeric_limits<float>::max());
+        glm::vec3 box_max(-std::numeric_limits<float>::max());
+        for (auto const &point : points) {
+            box_min = glm::min(box_min, point);
+            box_max = glm::max(box_max, point);
+        }
+
+        json11::Json::object accessor = (*accessors)[accessor_idx].object_items();
+        accessor["min"] = json11::Json::array{box_min.x, box_min.y, box_min.z};
+        accessor["max"] = json11::Json::array{box_max.x, box_max.y, box_max.z};
+        (*accessors)[accessor_idx] = accessor;
+    }
+
+
+    bool writeGlb(std::string const &path, DomeMesh const &mesh, std::vector<PointSet> const &point_sets) {
+
+        std::vector<char> binary;
+        json11::Json::array buffer_views;
+        json11::Json::array accessors;
+        json11::Json::array meshes;
+        json11::Json::array nodes;
+        json11::Json::array scene_nodes;
+
+        // the warp mesh lies in the z = 0 plane, glTF positions are three dimensional
+        unsigned long num_vertices = mesh.numVertices();
+        if (num_vertices > 0 && mesh.numIndices() > 0) {
+            std::vector<glm::vec3> positions(num_vertices);
+            std::vector<glm::vec2> texture_coords(num_vertices);
+            for (unsigned long i = 0; i < num_vertices; ++i) {
+                float const *vertex = &mesh.vertices[i * DomeMesh::FLOATS_PER_VERTEX];
+                positions[i] = glm::vec3(vertex[0], vertex[1], 0.0f);
+                texture_coords[i] = glm::vec2(vertex[2], vertex[3]);
+            }
+
+            int position_idx = addAccessor(&binary, &buffer_views, &accessors,
+                                           positions.data(), positions.size() * sizeof(glm::vec3),
+                                           num_vertices, GL_TYPE_FLOAT, "VEC3", GL_TARGET_ARRAY_BUFFER);
+            addBounds(&accessors, position_idx, positions);
+            int texture_idx = addAccessor(&binary, &buffer_views, &accessors,
+                                          texture_coords.data(), texture_coords.size() * sizeof(glm::vec2),
+                                          num_vertices, GL_TYPE_FLOAT, "VEC2", GL_TARGET_ARRAY_BUFFER);
+            int index_idx = addAccessor(&binary, &buffer_views, &accessors,
+                                        mesh.indexData(), mesh.indexBytes(), mesh.numIndices(),
+                                        mesh.is16Bit() ? GL_TYPE_UNSIGNED_SHORT : GL_TYPE_UNSIGNED_INT,
+                                        "SCALAR", GL_TARGET_ELEMENT_ARRAY_BUFFER);
+
+            meshes.push_back(json11::Json::object{
+                    {"name",       "warp_mesh"},
+                    {"primitives", json11::Json::array{json11::Json::object{
+                            {"attributes", json11::Json::object{
+                                    {"POSITION",   position_idx},
+                                    {"TEXCOORD_0", texture_idx}
+                            }},
+                            {"indices",    index_idx},
+                            {"mode",       GLTF_MODE_TRIANGLES}
+                    }}}
+            });
+        }
+
+        for (auto const &point_set : point_sets) {
+            std::vector<glm::vec3> const &points = *point_set.points;
+            if (points.empty()) {
+                continue;
+            }
+
+            int position_idx = addAccessor(&binary, &buffer_views, &accessors,
+                                           points.data(), points.size() * sizeof(glm::vec3),
+                                           points.size(), GL_TYPE_FLOAT, "VEC3", GL_TARGET_ARRAY_BUFFER);
+            addBounds(&accessors, position_idx, points);
+
+            meshes.push_back(json11::Json::object{
+                    {"name",       point_set.name},
+                    {"primitives", json11::Json::array{json11::Json::object{
+                            {"attributes", json11::Json::object{{"POSITION", position_idx}}},
+                            {"mode",       GLTF_MODE_POINTS}
+                    }}}
+            });
+        }
+
+        for (unsigned long i = 0; i < meshes.size(); ++i) {
+            nodes.push_back(json11::Json::object{
+                    {"name", meshes[i]["name"]},
+                    {"mesh", (int) i}
+            });
+            scene_nodes.push_back((int) i);
+        }
+        align4(&binary, 0);
+
+        json11::Json::object document{
+                {"asset",   json11::Json::object{{"version", "2.0"}, {"generator", "raycast"}}},
+                {"scene",   0},
+                {"scenes",  json11::Json::array{json11::Json::object{{"nodes", scene_nodes}}}},
+                {"nodes",   nodes},
+                {"meshes",  meshes}
+        };
+        if (!binary.empty()) {
+            document["buffers"] = json11::Json::array{json11::Json::object{{"byteLength", (double) binary.size()}}};
+            document["bufferViews"] = buffer_views;
+            document["accessors"] = accessors;
+        }
+
+        // the json chunk gets padded with spaces, the binary chunk with zeros
+        std::vector<char> json;
+        append(&json, json11::Json(document).dump());
+        align4(&json, ' ');
+
+        unsigned int total_length = (unsigned int) (12 + 8 + json.size() + (binary.empty() ? 0 : 8 + binary.size()));
+        unsigned int header[3] = {GLB_MAGIC, GLB_VERSION, total_length};
+        unsigned int json_chunk[2] = {(unsigned int) json.size(), GLB_CHUNK_JSON};
+        unsigned int binary_chunk[2] = {(unsigned int) binary.size(), GLB_CHUNK_BIN};
+        toLittleEndian((char *) header, sizeof(header), sizeof(unsigned int));
+        toLittleEndian((char *) json_chunk, sizeof(json_chunk), sizeof(unsigned int));
+        toLittleEndian((char *) binary_chunk, sizeof(binary_chunk), sizeof(unsigned int));
+
+        std::vector<char> buffer;
+        buffer.reserve(total_length);
+        append(&buffer, header, sizeof(header));
+        append(&buffer, json_chunk, sizeof(json_chunk));
+        append(&buffer, json.data(), json.size());
+        if (!binary.empty()) {
+            append(&buffer, binary_chunk, sizeof(binary_chunk));
+            append(&buffer, binary.data(), binary.size());
+        }
+
+        return writeFile(path, buffer);
+    }
+}
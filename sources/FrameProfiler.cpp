@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <lib/json11.hpp>
+
+#include "FrameProfiler.hpp"
+
+// frames a timer query gets to finish before its slot is needed again
+#define QUERY_RING_SIZE 4
+
+// histogram bins of the json dump, the last bin collects everything slower
+#define HISTOGRAM_BIN_MS 0.5f
+#define HISTOGRAM_NUM_BINS 100
+
+#define FRAME_SERIES 0
+#define GPU_SERIES 1
+
+
+void FrameProfiler::Series::add(float ms, unsigned long window_size) {
+    if (this->samples.size() < window_size) {
+        this->samples.push_back(ms);
+    } else {
+        this->samples[this->next] = ms;
+    }
+    this->next = (this->next + 1) % window_size;
+    ++this->total_count;
+    this->max = std::max(this->max, ms);
+}
+
+
+float FrameProfiler::Series::percentile(float p) const {
+    if (this->samples.empty()) {
+        return 0.0f;
+    }
+    std::vector<float> sorted(this->samples);
+    unsigned long rank = std::min((unsigned long) (p * sorted.size()), (unsigned long) sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+
+/**
+ * c'tor
+ * @param window_size
+ */
+FrameProfiler::FrameProfiler(unsigned long window_size)
+        : _window_size(std::max(window_size, 1ul))
+        , _has_frame(false)
+        , _query_idx(0)
+        , _query_running(false) {
+    for (char const *name : {"frame", "gpu"}) {
+        Series series;
+        series.name = name;
+        series.next = 0;
+        series.total_count = 0;
+        series.max = 0.0f;
+        this->_series.push_back(series);
+    }
+}
+
+
+void FrameProfiler::initialize() {
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query) {
+        std::cout << "timer queries not supported, gpu times stay empty" << std::endl;
+        return;
+    }
+    this->_queries.resize(QUERY_RING_SIZE);
+    this->_query_pending.assign(QUERY_RING_SIZE, false);
+    glGenQueries(QUERY_RING_SIZE, this->_queries.data());
+}
+
+
+int FrameProfiler::addPhase(std::string const &name) {
+    Series series;
+    series.name = name;
+    series.next = 0;
+    series.total_count = 0;
+    series.max = 0.0f;
+    this->_series.push_back(series);
+    return (int) this->_series.size() - 1;
+}
+
+
+void FrameProfiler::beginFrame() {
+
+    Clock::time_point now = Clock::now();
+    if (this->_has_frame) {
+        float ms = std::chrono::duration<float, std::milli>(now - this->_frame_start).count();
+        this->_series[FRAME_SERIES].add(ms, this->_window_size);
+    }
+    this->_frame_start = now;
+    this->_last_mark = now;
+    this->_has_frame = true;
+
+    if (this->_queries.empty()) {
+        return;
+    }
+
+    // collect whatever finished without waiting for the rest
+    for (unsigned long i = 0; i < this->_queries.size(); ++i) {
+        if (!this->_query_pending[i]) {
+            continue;
+        }
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(this->_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_TRUE) {
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(this->_queries[i], GL_QUERY_RESULT, &elapsed_ns);
+            this->_series[GPU_SERIES].add(float(elapsed_ns) * 1e-6f, this->_window_size);
+            this->_query_pending[i] = false;
+        }
+    }
+
+    // a slot still pending after a full ring means the gpu lags far behind, skip timing this frame
+    if (!this->_query_pending[this->_query_idx]) {
+        glBeginQuery(GL_TIME_ELAPSED, this->_queries[this->_query_idx]);
+        this->_query_running = true;
+    }
+}
+
+
+void FrameProfiler::mark(int phase_idx) {
+    Clock::time_point now = Clock::now();
+    float ms = std::chrono::duration<float, std::milli>(now - this->_last_mark).count();
+    this->_series[phase_idx].add(ms, this->_window_size);
+    this->_last_mark = now;
+}
+
+
+void FrameProfiler::endFrame() {
+    if (this->_query_running) {
+        glEndQuery(GL_TIME_ELAPSED);
+        this->_query_pending[this->_query_idx] = true;
+        this->_query_running = false;
+    }
+    if (!this->_queries.empty()) {
+        this->_query_idx = (this->_query_idx + 1) % this->_queries.size();
+    }
+}
+
+
+std::string FrameProfiler::summary() const {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    for (int series_idx : {FRAME_SERIES, GPU_SERIES}) {
+        Series const &series = this->_series[series_idx];
+        ss << series.name << " ms p50/95/99: "
+           << series.percentile(0.5f) << "/" << series.percentile(0.95f) << "/" << series.percentile(0.99f) << "  ";
+    }
+    return ss.str();
+}
+
+
+bool FrameProfiler::writeJson(std::string const &file_path) const {
+
+    json11::Json::array series_list;
+    for (auto const &series : this->_series) {
+        std::vector<int> histogram(HISTOGRAM_NUM_BINS, 0);
+        for (float ms : series.samples) {
+            int bin = std::min((int) (ms / HISTOGRAM_BIN_MS), HISTOGRAM_NUM_BINS - 1);
+            ++histogram[bin];
+        }
+
+        series_list.push_back(json11::Json::object{
+                {"name",        series.name},
+                {"total_count", (double) series.total_count},
+                {"window_count", (int) series.samples.size()},
+                {"p50",         series.percentile(0.5f)},
+                {"p95",         series.percentile(0.95f)},
+                {"p99",         series.percentile(0.99f)},
+                {"max",         series.max},
+                {"histogram",   histogram}
+        });
+    }
+
+    json11::Json json = json11::Json::object{
+            {"window_size",      (double) this->_window_size},
+            {"histogram_bin_ms", HISTOGRAM_BIN_MS},
+            {"series",           series_list}
+    };
+
+    std::ofstream ofs(file_path);
+    ofs << json.dump() << std::endl;
+    if (!ofs.good()) {
+        std::cout << "failed to write frame profile '" << file_path << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+void FrameProfiler::release() {
+    if (!this->_queries.empty()) {
+        glDeleteQueries((GLsizei) this->_queries.size(), this->_queries.data());
+        this->_queries.clear();
+        this->_query_pending.clear();
+    }
+}
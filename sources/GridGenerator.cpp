@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "GridGenerator.hpp"
+#include "Utility.hpp"
+
+/**
+ * Writes a scaled copy of the given x and y tables.
+ * @param scale
+ * @param x_table
+ * @param y_table
+ * @param count
+ * @param x
+ * @param y
+ */
+static void scaleTables(float scale, float const *x_table, float const *y_table, int count, float *x, float *y) {
+    int i = 0;
+#ifdef __SSE__
+    __m128 factor = _mm_set1_ps(scale);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(x + i, _mm_mul_ps(factor, _mm_loadu_ps(x_table + i)));
+        _mm_storeu_ps(y + i, _mm_mul_ps(factor, _mm_loadu_ps(y_table + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        x[i] = scale * x_table[i];
+        y[i] = scale * y_table[i];
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SAMPLE GRID
+// ---------------------------------------------------------------------------
+
+/**
+ * c'tor
+ */
+SampleGrid::SampleGrid()
+        : rows(0)
+        , columns(0)
+        , has_center(false)
+        , wraps(false) {}
+
+
+int SampleGrid::index(int row, int column) const {
+    return (has_center ? 1 : 0) + row * columns + column;
+}
+
+
+bool SampleGrid::structured() const {
+    return rows > 0;
+}
+
+
+unsigned long SampleGrid::size() const {
+    return x.size();
+}
+
+// ---------------------------------------------------------------------------
+// GRID GENERATOR
+// ---------------------------------------------------------------------------
+
+/**
+ * c'tor
+ * @param layout
+ * @param rows
+ * @param columns
+ */
+GridGenerator::GridGenerator(Layout layout, int rows, int columns)
+        : _layout(layout)
+        , _rows(std::max(rows, 1))
+        , _columns(std::max(columns, 1))
+        , _pixel_width(_columns)
+        , _pixel_height(_rows)
+        , _pixel_stride(1) {}
+
+
+GridGenerator GridGenerator::pixelAligned(int pixel_width, int pixel_height, int pixel_stride) {
+    pixel_stride = std::max(pixel_stride, 1);
+
+    // the last row and column pick up the remainder of the image
+    GridGenerator generator(PIXEL,
+                            (pixel_height + pixel_stride - 1) / pixel_stride,
+                            (pixel_width + pixel_stride - 1) / pixel_stride);
+    generator._pixel_width = std::max(pixel_width, 1);
+    generator._pixel_height = std::max(pixel_height, 1);
+    generator._pixel_stride = pixel_stride;
+    return generator;
+}
+
+
+void GridGenerator::generate(float half_width, float half_height, SampleGrid *grid) const {
+
+    switch (_layout) {
+        case POLAR:
+        case CONCENTRIC:
+            generateRadial(half_width, grid);
+            break;
+        case RECTANGULAR:
+            generateRectangular(half_width, half_height, grid);
+            break;
+        case HALTON:
+        case SOBOL:
+            generateLowDiscrepancy(half_width, half_height, grid);
+            break;
+        case PIXEL:
+            generatePixelAligned(half_width, half_height, grid);
+            break;
+    }
+}
+
+
+bool GridGenerator::parseLayout(std::string const &name, Layout *layout) {
+    if (name == "polar") {
+        *layout = POLAR;
+    } else if (name == "concentric") {
+        *layout = CONCENTRIC;
+    } else if (name == "rectangular") {
+        *layout = RECTANGULAR;
+    } else if (name == "halton") {
+        *layout = HALTON;
+    } else if (name == "sobol") {
+        *layout = SOBOL;
+    } else if (name == "pixel") {
+        *layout = PIXEL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+void GridGenerator::generateRadial(float radius, SampleGrid *grid) const {
+
+    grid->rows = _rows;
+    grid->columns = _columns;
+    grid->has_center = true;
+    grid->wraps = true;
+    grid->x.resize((unsigned long) (1 + _rows * _columns));
+    grid->y.resize(grid->x.size());
+
+    // every ring shares the same angles
+    std::vector<float> cos_table((unsigned long) _columns);
+    std::vector<float> sin_table((unsigned long) _columns);
+    for (int column = 0; column < _columns; ++column) {
+        double angle = 2.0 * M_PI * column / _columns;
+        cos_table[column] = (float) std::cos(angle);
+        sin_table[column] = (float) std::sin(angle);
+    }
+
+    grid->x[0] = 0.0f;
+    grid->y[0] = 0.0f;
+    for (int row = 0; row < _rows; ++row) {
+
+        // concentric rings grow with the square root to keep the ring areas equal
+        float ring_radius;
+        if (_layout == CONCENTRIC) {
+            ring_radius = radius * std::sqrt((row + 1) / (float) _rows);
+        } else {
+            ring_radius = radius * (row + 1) / (float) _rows;
+        }
+
+        int offset = grid->index(row, 0);
+        scaleTables(ring_radius, cos_table.data(), sin_table.data(), _columns, &grid->x[offset], &grid->y[offset]);
+    }
+}
+
+
+void GridGenerator::generateRectangular(float half_width, float half_height, SampleGrid *grid) const {
+
+    grid->rows = _rows;
+    grid->columns = _columns;
+    grid->has_center = false;
+    grid->wraps = false;
+    grid->x.resize((unsigned long) (_rows * _columns));
+    grid->y.resize(grid->x.size());
+
+    // samples sit in the centers of equally sized cells
+    std::vector<float> row_x((unsigned long) _columns);
+    for (int column = 0; column < _columns; ++column) {
+        row_x[column] = half_width * (2.0f * (column + 0.5f) / _columns - 1.0f);
+    }
+
+    for (int row = 0; row < _rows; ++row) {
+        float row_y = half_height * (1.0f - 2.0f * (row + 0.5f) / _rows);
+        int offset = grid->index(row, 0);
+        std::copy(row_x.begin(), row_x.end(), grid->x.begin() + offset);
+        std::fill(grid->y.begin() + offset, grid->y.begin() + offset + _columns, row_y);
+    }
+}
+
+
+void GridGenerator::generateLowDiscrepancy(float half_width, float half_height, SampleGrid *grid) const {
+
+    grid->rows = 0;
+    grid->columns = 0;
+    grid->has_center = false;
+    grid->wraps = false;
+
+    unsigned int num_samples = (unsigned int) (_rows * _columns);
+    grid->x.resize(num_samples);
+    grid->y.resize(num_samples);
+
+    if (_layout == HALTON) {
+        for (unsigned int i = 0; i < num_samples; ++i) {
+            grid->x[i] = utility::radicalInverse(i, 2);
+            grid->y[i] = utility::radicalInverse(i, 3);
+        }
+    } else {
+        // two dimensional sobol sequence in gray code order
+        unsigned int directions_x[32];
+        unsigned int directions_y[32];
+        for (int bit = 0; bit < 32; ++bit) {
+            directions_x[bit] = 1u << (31 - bit);
+            directions_y[bit] = bit == 0 ? 1u << 31 : directions_y[bit - 1] ^ (directions_y[bit - 1] >> 1);
+        }
+
+        unsigned int sobol_x = 0;
+        unsigned int sobol_y = 0;
+        for (unsigned int i = 0; i < num_samples; ++i) {
+            grid->x[i] = sobol_x * (1.0f / 4294967296.0f);
+            grid->y[i] = sobol_y * (1.0f / 4294967296.0f);
+
+            // the next point flips the direction of the lowest zero bit of i
+            int bit = 0;
+            while ((i >> bit) & 1u) {
+                ++bit;
+            }
+            sobol_x ^= directions_x[bit];
+            sobol_y ^= directions_y[bit];
+        }
+    }
+
+    // stretch the unit square over the near plane
+    for (unsigned int i = 0; i < num_samples; ++i) {
+        grid->x[i] = half_width * (2.0f * grid->x[i] - 1.0f);
+        grid->y[i] = half_height * (2.0f * grid->y[i] - 1.0f);
+    }
+}
+
+void GridGenerator::generatePixelAligned(float half_width, float half_height, SampleGrid *grid) const {
+
+    grid->rows = _rows;
+    grid->columns = _columns;
+    grid->has_center = false;
+    grid->wraps = false;
+    grid->x.resize((unsigned long) (_rows * _columns));
+    grid->y.resize(grid->x.size());
+
+    // rows run from the top of the image, columns from its left
+    std::vector<float> row_x((unsigned long) _columns);
+    for (int column = 0; column < _columns; ++column) {
+        int pixel = column * _pixel_stride;
+        row_x[column] = half_width * (2.0f * (pixel + 0.5f) / _pixel_width - 1.0f);
+    }
+
+    for (int row = 0; row < _rows; ++row) {
+        int pixel = row * _pixel_stride;
+        float row_y = half_height * (1.0f - 2.0f * (pixel + 0.5f) / _pixel_height);
+        int offset = grid->index(row, 0);
+        std::copy(row_x.begin(), row_x.end(), grid->x.begin() + offset);
+        std::fill(grid->y.begin() + offset, grid->y.begin() + offset + _columns, row_y);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// GETTER
+// ---------------------------------------------------------------------------
+
+GridGenerator::Layout GridGenerator::get_layout() const {
+    return _layout;
+}
+
+int GridGenerator::get_rows() const {
+    return _rows;
+}
+
+int GridGenerator::get_columns() const {
+    return _columns;
+}
+
+int GridGenerator::get_pixel_stride() const {
+    return _pixel_stride;
+}
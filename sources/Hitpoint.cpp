@@ -12,7 +12,11 @@
 Hitpoint::Hitpoint()
         : position(glm::vec3())
         , normal(glm::vec3())
-        , t(0.0) {}
+        , t(0.0)
+        , position_dx(glm::vec3())
+        , position_dy(glm::vec3())
+        , normal_dx(glm::vec3())
+        , normal_dy(glm::vec3()) {}
 
 
 /**
@@ -22,7 +26,11 @@ Hitpoint::Hitpoint()
 Hitpoint::Hitpoint(const glm::vec3 &position)
         : position(position)
         , normal(glm::vec3())
-        , t(0.0) {}
+        , t(0.0)
+        , position_dx(glm::vec3())
+        , position_dy(glm::vec3())
+        , normal_dx(glm::vec3())
+        , normal_dy(glm::vec3()) {}
 
 
 /**
@@ -34,7 +42,11 @@ Hitpoint::Hitpoint(const glm::vec3 &position)
 Hitpoint::Hitpoint(const glm::vec3 &position, const glm::vec3 &normal, double t)
         : position(position)
         , normal(normal)
-        , t(t) {}
+        , t(t)
+        , position_dx(glm::vec3())
+        , position_dy(glm::vec3())
+        , normal_dx(glm::vec3())
+        , normal_dy(glm::vec3()) {}
 
 
 /**
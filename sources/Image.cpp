@@ -0,0 +1,104 @@
+#include <fstream>
+#include <iostream>
+
+#include "Image.hpp"
+
+/**
+ * c'tor
+ */
+Image::Image()
+        : width(0)
+        , height(0) {}
+
+
+/**
+ * c'tor
+ * @param width
+ * @param height
+ */
+Image::Image(int width, int height)
+        : width(0)
+        , height(0) {
+    this->resize(width, height);
+}
+
+
+void Image::resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    this->pixels.resize((unsigned long) width * height * CHANNELS);
+}
+
+
+unsigned char *Image::row(int y) {
+    return this->pixels.data() + (unsigned long) y * this->width * CHANNELS;
+}
+
+
+unsigned char const *Image::row(int y) const {
+    return this->pixels.data() + (unsigned long) y * this->width * CHANNELS;
+}
+
+
+/**
+ * Reads the next header number, skipping whitespace and comments
+ * @param ifs
+ * @param value
+ * @return
+ */
+static bool readHeaderValue(std::ifstream &ifs, int *value) {
+    for (;;) {
+        int c = ifs.peek();
+        if (c == '#') {
+            std::string comment;
+            std::getline(ifs, comment);
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            ifs.get();
+        } else {
+            break;
+        }
+    }
+    return (bool) (ifs >> *value);
+}
+
+
+bool Image::readPpm(std::string const &path, Image *image) {
+
+    std::ifstream ifs(path, std::ios::binary);
+    std::string magic;
+    if (!(ifs >> magic) || magic != "P6") {
+        std::cout << "'" << path << "' is no binary ppm" << std::endl;
+        return false;
+    }
+
+    int width, height, max_value;
+    if (!readHeaderValue(ifs, &width) || !readHeaderValue(ifs, &height) || !readHeaderValue(ifs, &max_value) ||
+        width <= 0 || height <= 0 || max_value != 255) {
+        std::cout << "unsupported ppm header in '" << path << "'" << std::endl;
+        return false;
+    }
+
+    // exactly one whitespace separates the header from the pixels
+    ifs.get();
+
+    image->resize(width, height);
+    ifs.read((char *) image->pixels.data(), image->pixels.size());
+    if (!ifs) {
+        std::cout << "'" << path << "' is truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool Image::writePpm(std::string const &path) const {
+
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << "P6\n" << this->width << " " << this->height << "\n255\n";
+    ofs.write((char const *) this->pixels.data(), this->pixels.size());
+    if (!ofs.good()) {
+        std::cout << "failed to write '" << path << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
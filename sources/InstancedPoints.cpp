@@ -0,0 +1,114 @@
+#include "InstancedPoints.hpp"
+#include "ShaderUtil.hpp"
+
+/**
+ * c'tor
+ */
+InstancedPoints::InstancedPoints()
+        : _program_id(0)
+        , _mvp_location(-1)
+        , _marker_size_location(-1)
+        , _color_location(-1)
+        , _stream_buffers(nullptr)
+        , _marker_buffer_id(0)
+        , _num_marker_vertices(0) {}
+
+
+bool InstancedPoints::initialize(BufferManager *stream_buffers, GLuint marker_buffer_id, int num_marker_vertices,
+                                 char const *vertex_file_path, char const *fragment_file_path) {
+
+    this->_program_id = LoadShaders(vertex_file_path, fragment_file_path);
+    if (this->_program_id == 0) {
+        return false;
+    }
+
+    this->_mvp_location = glGetUniformLocation(this->_program_id, "MVP");
+    this->_marker_size_location = glGetUniformLocation(this->_program_id, "marker_size");
+    this->_color_location = glGetUniformLocation(this->_program_id, "marker_color");
+
+    this->_stream_buffers = stream_buffers;
+    this->_marker_buffer_id = marker_buffer_id;
+    this->_num_marker_vertices = num_marker_vertices;
+    return true;
+}
+
+
+int InstancedPoints::addSet(glm::vec3 const &color) {
+
+    PointSet set;
+    set.num_points = 0;
+    set.color = color;
+    set.visible = true;
+
+    glGenVertexArrays(1, &set.vertex_array_id);
+    glBindVertexArray(set.vertex_array_id);
+
+    // marker shape, the same for every instance
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, this->_marker_buffer_id);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *) 0);
+
+    // one position per instance, the pointer gets set by every upload
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+
+    glBindVertexArray(0);
+
+    this->_sets.push_back(set);
+    return (int) this->_sets.size() - 1;
+}
+
+
+void InstancedPoints::upload(int set_idx, ResultView<glm::vec3> const &points) {
+    PointSet &set = this->_sets[set_idx];
+    set.num_points = (GLsizei) points.size();
+
+    GLintptr offset = this->_stream_buffers->write(points.data(), points.size() * sizeof(glm::vec3));
+
+    glBindVertexArray(set.vertex_array_id);
+    glBindBuffer(GL_ARRAY_BUFFER, this->_stream_buffers->get_buffer_id());
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *) offset);
+    glBindVertexArray(0);
+}
+
+
+void InstancedPoints::set_visible(int set_idx, bool visible) {
+    this->_sets[set_idx].visible = visible;
+}
+
+
+bool InstancedPoints::is_visible(int set_idx) const {
+    return this->_sets[set_idx].visible;
+}
+
+
+void InstancedPoints::draw(glm::mat4 const &mvp, float marker_size) const {
+
+    glUseProgram(this->_program_id);
+    glUniformMatrix4fv(this->_mvp_location, 1, GL_FALSE, &mvp[0][0]);
+    glUniform1f(this->_marker_size_location, marker_size);
+
+    for (auto const &set : this->_sets) {
+        if (!set.visible || set.num_points == 0) {
+            continue;
+        }
+        glUniform3fv(this->_color_location, 1, &set.color[0]);
+        glBindVertexArray(set.vertex_array_id);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, this->_num_marker_vertices, set.num_points);
+    }
+
+    glBindVertexArray(0);
+}
+
+
+void InstancedPoints::release() {
+    for (auto &set : this->_sets) {
+        glDeleteVertexArrays(1, &set.vertex_array_id);
+    }
+    this->_sets.clear();
+
+    if (this->_program_id != 0) {
+        glDeleteProgram(this->_program_id);
+        this->_program_id = 0;
+    }
+}
@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <lib/json11.hpp>
+
+#include "InterReflection.hpp"
+#include "DomeProjector.hpp"
+#include "Parallel.hpp"
+#include "Utility.hpp"
+
+// paths traced by a worker before it merges its light and picks the next tile
+#define PATH_TILE_SIZE 4096
+
+// two halton dimensions per bounce
+#define MAX_BOUNCES 16
+
+static unsigned int const PRIMES[MAX_BOUNCES * 2] = {
+        2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+        59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131
+};
+
+/**
+ * Scrambles an integer into a well spread offset in [0, 1)
+ * @param value
+ * @return
+ */
+static float hashToUnit(unsigned int value) {
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+    return (value >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * c'tor
+ */
+InterReflection::InterReflection()
+        : _center(glm::vec3())
+        , _radius(1.0f)
+        , _albedo(0.0f)
+        , _max_bounces(0)
+        , _num_passes(0)
+        , _error(1.0f) {}
+
+
+void InterReflection::setup(Sphere const &dome, ResultView<glm::vec3> const &vertices,
+                            std::vector<unsigned int> const &indices, ResultView<glm::vec3> const &hits,
+                            float albedo, int max_bounces) {
+
+    this->_center = dome.get_position();
+    this->_radius = dome.get_radius();
+    this->_albedo = albedo;
+    this->_max_bounces = std::min(std::max(max_bounces, 0), MAX_BOUNCES);
+    this->_vertices.assign(vertices.begin(), vertices.end());
+
+    // every vertex collects the light of a third of its triangles
+    this->_vertex_areas.assign(vertices.size(), 0.0f);
+    float max_edge = 0.0f;
+    for (unsigned long i = 0; i + 2 < indices.size(); i += 3) {
+        glm::vec3 const &a = vertices[indices[i]];
+        glm::vec3 const &b = vertices[indices[i + 1]];
+        glm::vec3 const &c = vertices[indices[i + 2]];
+        float third = glm::length(glm::cross(b - a, c - a)) / 6.0f;
+        for (int corner = 0; corner < 3; ++corner) {
+            this->_vertex_areas[indices[i + corner]] += third;
+        }
+        max_edge = std::max(max_edge, std::max(glm::length(b - a), std::max(glm::length(c - b), glm::length(a - c))));
+    }
+
+    // any point on the dome lies within an edge of its closest vertex,
+    // so boxes of that size always reach the closest vertex
+    std::vector<glm::vec3> box_min(vertices.size());
+    std::vector<glm::vec3> box_max(vertices.size());
+    for (unsigned long i = 0; i < vertices.size(); ++i) {
+        box_min[i] = vertices[i] - glm::vec3(max_edge);
+        box_max[i] = vertices[i] + glm::vec3(max_edge);
+    }
+    this->_vertex_grid.build(box_min, box_max, std::max((int) std::cbrt((double) vertices.size()), 1));
+
+    this->_hits.clear();
+    for (auto const &hit : hits) {
+        if (!DomeProjector::isMiss(hit)) {
+            this->_hits.push_back(hit);
+        }
+    }
+
+    this->_direct.assign(vertices.size(), 0.0f);
+    float share = this->_hits.empty() ? 0.0f : 1.0f / this->_hits.size();
+    for (auto const &hit : this->_hits) {
+        this->_direct[this->nearestVertex(hit)] += share;
+    }
+    for (unsigned long i = 0; i < vertices.size(); ++i) {
+        this->_direct[i] = this->_vertex_areas[i] > 0.0f ? this->_direct[i] / this->_vertex_areas[i] : 0.0f;
+    }
+
+    this->_even_sums.assign(vertices.size(), 0.0);
+    this->_odd_sums.assign(vertices.size(), 0.0);
+    this->_num_passes = 0;
+    this->_error = 1.0f;
+}
+
+
+float InterReflection::refine() {
+
+    std::vector<double> &sums = this->_num_passes % 2 == 0 ? this->_even_sums : this->_odd_sums;
+    unsigned int pass = (unsigned int) this->_num_passes;
+
+    std::mutex merge_mutex;
+    parallel::forTiles(0, (long) this->_hits.size(), PATH_TILE_SIZE, [&](long begin, long end) {
+        std::vector<double> tile_sums(this->_vertices.size(), 0.0);
+        for (long i = begin; i < end; ++i) {
+            this->tracePath((unsigned long) i, pass, &tile_sums);
+        }
+
+        std::lock_guard<std::mutex> lock(merge_mutex);
+        for (unsigned long v = 0; v < tile_sums.size(); ++v) {
+            sums[v] += tile_sums[v];
+        }
+    });
+    ++this->_num_passes;
+
+    // the even and odd passes form two nearly independent estimates,
+    // half their difference approximates the error of the combined estimate
+    if (this->_num_passes < 2) {
+        return this->_error;
+    }
+    double num_even = (this->_num_passes + 1) / 2;
+    double num_odd = this->_num_passes / 2;
+    double difference_sqr = 0.0;
+    double mean_sqr = 0.0;
+    for (unsigned long v = 0; v < this->_vertices.size(); ++v) {
+        double even = this->_even_sums[v] / num_even;
+        double odd = this->_odd_sums[v] / num_odd;
+        double mean = (this->_even_sums[v] + this->_odd_sums[v]) / this->_num_passes;
+        difference_sqr += (even - odd) * (even - odd);
+        mean_sqr += mean * mean;
+    }
+    this->_error = mean_sqr > 0.0 ? (float) (0.5 * std::sqrt(difference_sqr / mean_sqr)) : 0.0f;
+
+    return this->_error;
+}
+
+
+bool InterReflection::estimate(float tolerance, int max_passes, double max_seconds) {
+
+    auto start = std::chrono::steady_clock::now();
+    while (this->_num_passes < max_passes) {
+        float error = this->refine();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "\rinter-reflection pass " << this->_num_passes
+                  << " error " << error * 100.0f << "%"
+                  << " stray/direct " << this->strayRatio()
+                  << " (" << seconds << " s)" << std::flush;
+
+        if (this->_num_passes >= 2 && error <= tolerance) {
+            std::cout << std::endl;
+            return true;
+        }
+        if (seconds >= max_seconds) {
+            break;
+        }
+    }
+
+    std::cout << std::endl;
+    return false;
+}
+
+
+void InterReflection::tracePath(unsigned long hit_idx, unsigned int pass, std::vector<double> *sums) const {
+
+    glm::vec3 position = this->_hits[hit_idx];
+    double flux = 1.0 / this->_hits.size();
+
+    for (int bounce = 0; bounce < this->_max_bounces; ++bounce) {
+
+        // halton point of this pass, shifted per hit and bounce
+        unsigned int seed = (unsigned int) hit_idx * MAX_BOUNCES + bounce;
+        float u1 = utility::radicalInverse(pass, PRIMES[bounce * 2]) + hashToUnit(seed * 2);
+        float u2 = utility::radicalInverse(pass, PRIMES[bounce * 2 + 1]) + hashToUnit(seed * 2 + 1);
+        u1 -= std::floor(u1);
+        u2 -= std::floor(u2);
+
+        // cosine weighted direction around the inward normal
+        glm::vec3 normal = (this->_center - position) / this->_radius;
+        glm::vec3 helper = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 tangent = glm::normalize(glm::cross(helper, normal));
+        glm::vec3 bitangent = glm::cross(normal, tangent);
+
+        float cos_theta = std::sqrt(1.0f - u1);
+        float sin_theta = std::sqrt(u1);
+        float phi = 2.0f * (float) M_PI * u2;
+        glm::vec3 direction = sin_theta * std::cos(phi) * tangent +
+                              sin_theta * std::sin(phi) * bitangent +
+                              cos_theta * normal;
+
+        // the chord of a sphere leaving at angle theta to the normal is 2 r cos theta,
+        // projecting back onto the sphere keeps long paths from drifting
+        position += 2.0f * this->_radius * cos_theta * direction;
+        position = this->_center + glm::normalize(position - this->_center) * this->_radius;
+        flux *= this->_albedo;
+
+        if (position.y < this->_center.y) {
+            return;
+        }
+        (*sums)[this->nearestVertex(position)] += flux;
+    }
+}
+
+
+int InterReflection::nearestVertex(glm::vec3 const &point) const {
+
+    int const *begin;
+    int const *end;
+    this->_vertex_grid.query(point, &begin, &end);
+
+    int nearest_idx = 0;
+    float nearest_distance = std::numeric_limits<float>::max();
+    for (int const *it = begin; it != end; ++it) {
+        glm::vec3 offset = this->_vertices[*it] - point;
+        float distance = glm::dot(offset, offset);
+        if (distance < nearest_distance) {
+            nearest_distance = distance;
+            nearest_idx = *it;
+        }
+    }
+
+    // points off the grid search all vertices
+    if (begin == end) {
+        for (int i = 0; i < (int) this->_vertices.size(); ++i) {
+            glm::vec3 offset = this->_vertices[i] - point;
+            float distance = glm::dot(offset, offset);
+            if (distance < nearest_distance) {
+                nearest_distance = distance;
+                nearest_idx = i;
+            }
+        }
+    }
+
+    return nearest_idx;
+}
+
+
+float InterReflection::strayRatio() const {
+    double direct = 0.0;
+    double indirect = 0.0;
+    for (unsigned long v = 0; v < this->_vertices.size(); ++v) {
+        direct += this->_direct[v] * this->_vertex_areas[v];
+    }
+    for (unsigned long v = 0; v < this->_vertices.size(); ++v) {
+        indirect += this->_even_sums[v] + this->_odd_sums[v];
+    }
+    if (direct <= 0.0 || this->_num_passes == 0) {
+        return 0.0f;
+    }
+    return (float) (indirect / this->_num_passes / direct);
+}
+
+
+bool InterReflection::writeJson(std::string const &file_path) const {
+
+    std::vector<float> indirect = this->get_indirect();
+    json11::Json::array vertices;
+    for (unsigned long v = 0; v < this->_vertices.size(); ++v) {
+        glm::vec3 const &position = this->_vertices[v];
+        vertices.push_back(json11::Json::array{position.x, position.y, position.z});
+    }
+
+    json11::Json json = json11::Json::object{
+            {"albedo",       this->_albedo},
+            {"max_bounces",  this->_max_bounces},
+            {"num_paths",    (double) this->_hits.size() * this->_num_passes},
+            {"error",        this->_error},
+            {"stray_ratio",  this->strayRatio()},
+            {"vertices",     vertices},
+            {"direct",       this->_direct},
+            {"indirect",     indirect}
+    };
+
+    std::ofstream ofs(file_path);
+    ofs << json.dump() << std::endl;
+    if (!ofs.good()) {
+        std::cout << "failed to write inter-reflection estimate '" << file_path << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+std::vector<float> const &InterReflection::get_direct() const {
+    return this->_direct;
+}
+
+
+std::vector<float> InterReflection::get_indirect() const {
+    std::vector<float> indirect(this->_vertices.size(), 0.0f);
+    if (this->_num_passes == 0) {
+        return indirect;
+    }
+    for (unsigned long v = 0; v < indirect.size(); ++v) {
+        double flux = (this->_even_sums[v] + this->_odd_sums[v]) / this->_num_passes;
+        indirect[v] = this->_vertex_areas[v] > 0.0f ? (float) (flux / this->_vertex_areas[v]) : 0.0f;
+    }
+    return indirect;
+}
+
+
+int InterReflection::get_num_passes() const {
+    return this->_num_passes;
+}
+
+
+float InterReflection::get_error() const {
+    return this->_error;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "MappingMetrics.hpp"
+
+/**
+ * c'tor
+ */
+MappingMetrics::MappingMetrics()
+        : num_rays(0)
+        , num_mirror_misses(0)
+        , num_dome_misses(0)
+        , num_below_equator(0)
+        , tolerance(0.0f)
+        , histogram_bin_width(0.0f)
+        , num_vertices(0)
+        , num_covered_vertices(0)
+        , num_unmapped_vertices(0)
+        , mean_snap_distance(0.0f)
+        , max_snap_distance(0.0f)
+        , num_distance_evaluations(0)
+        , num_walk_fallbacks(0) {}
+
+
+void MappingMetrics::resetRays(int dome_rings) {
+    num_rays = 0;
+    num_mirror_misses = 0;
+    num_dome_misses = 0;
+    num_below_equator = 0;
+
+    ring_hits.assign((unsigned long) std::max(dome_rings, 1), 0);
+    ring_hit_density.assign(ring_hits.size(), 0.0f);
+}
+
+
+void MappingMetrics::resetSnaps(float tolerance, int num_bins) {
+    this->tolerance = tolerance;
+
+    // the tolerance sits in the middle of the histogram
+    num_bins = std::max(num_bins, 2);
+    histogram_bin_width = 2.0f * tolerance / num_bins;
+    snap_histogram.assign((unsigned long) num_bins, 0);
+
+    num_vertices = 0;
+    num_covered_vertices = 0;
+    num_unmapped_vertices = 0;
+    mean_snap_distance = 0.0f;
+    max_snap_distance = 0.0f;
+    num_distance_evaluations = 0;
+    num_walk_fallbacks = 0;
+}
+
+
+void MappingMetrics::addSnap(float distance) {
+    ++num_vertices;
+
+    unsigned long bin = snap_histogram.size() - 1;
+    if (histogram_bin_width > 0.0f) {
+        bin = std::min(bin, (unsigned long) (distance / histogram_bin_width));
+    }
+    ++snap_histogram[bin];
+
+    if (distance <= tolerance) {
+        ++num_covered_vertices;
+    }
+
+    // running mean over all snapped vertices
+    unsigned int num_snapped = num_vertices - num_unmapped_vertices;
+    mean_snap_distance += (distance - mean_snap_distance) / num_snapped;
+    max_snap_distance = std::max(max_snap_distance, distance);
+}
+
+
+void MappingMetrics::addUnmapped() {
+    ++num_vertices;
+    ++num_unmapped_vertices;
+}
+
+
+float MappingMetrics::coverage() const {
+    if (num_vertices == 0) {
+        return 0.0f;
+    }
+    return 100.0f * num_covered_vertices / num_vertices;
+}
+
+
+float MappingMetrics::rayFraction(unsigned int count) const {
+    if (num_rays == 0) {
+        return 0.0f;
+    }
+    return float(count) / num_rays;
+}
+
+
+/**
+ * ostream
+ * @param os
+ * @param metrics
+ * @return
+ */
+std::ostream &operator<<(std::ostream &os, const MappingMetrics &metrics) {
+    os << "Mapping Metrics:" << "\n"
+       << "  rays: " << metrics.num_rays << "\n"
+       << "  lost at mirror: " << metrics.rayFraction(metrics.num_mirror_misses) << "\n"
+       << "  lost at dome: " << metrics.rayFraction(metrics.num_dome_misses) << "\n"
+       << "  lost below equator: " << metrics.rayFraction(metrics.num_below_equator) << "\n"
+       << "  coverage: " << metrics.coverage() << "% within " << metrics.tolerance << "\n"
+       << "  unmapped vertices: " << metrics.num_unmapped_vertices << "/" << metrics.num_vertices << "\n"
+       << "  snap distance: <mean: " << metrics.mean_snap_distance
+       << " max: " << metrics.max_snap_distance << ">\n"
+       << "  distance evaluations per vertex: "
+       << (metrics.num_vertices ? double(metrics.num_distance_evaluations) / metrics.num_vertices : 0.0)
+       << " (" << metrics.num_walk_fallbacks << " walk fallbacks)\n"
+       << "  snap histogram:\n";
+
+    for (unsigned long i = 0; i < metrics.snap_histogram.size(); ++i) {
+        os << "    " << std::setw(10) << (i * metrics.histogram_bin_width);
+        if (i + 1 == metrics.snap_histogram.size()) {
+            os << " +   ";
+        } else {
+            os << " .. " << std::setw(10) << ((i + 1) * metrics.histogram_bin_width) << " ";
+        }
+        os << metrics.snap_histogram[i] << "\n";
+    }
+
+    os << "  ring hit density:";
+    for (unsigned long i = 0; i < metrics.ring_hit_density.size(); ++i) {
+        os << "\n    ring " << std::setw(3) << i << ": " << metrics.ring_hits[i]
+           << " hits (" << metrics.ring_hit_density[i] << "/m^2)";
+    }
+
+    return os;
+}
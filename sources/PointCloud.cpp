@@ -0,0 +1,122 @@
+#include "PointCloud.hpp"
+#include "ShaderUtil.hpp"
+
+/**
+ * c'tor
+ */
+PointCloud::PointCloud()
+        : _program_id(0)
+        , _mvp_location(-1)
+        , _point_size_location(-1)
+        , _color_location(-1)
+        , _stream_buffers(nullptr) {}
+
+
+bool PointCloud::initialize(BufferManager *stream_buffers, char const *vertex_file_path,
+                            char const *fragment_file_path) {
+
+    this->_stream_buffers = stream_buffers;
+
+    this->_program_id = LoadShaders(vertex_file_path, fragment_file_path);
+    if (this->_program_id == 0) {
+        return false;
+    }
+
+    this->_mvp_location = glGetUniformLocation(this->_program_id, "MVP");
+    this->_point_size_location = glGetUniformLocation(this->_program_id, "point_size");
+    this->_color_location = glGetUniformLocation(this->_program_id, "point_color");
+
+    // the vertex shader sets the size of the points
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    return true;
+}
+
+
+int PointCloud::addCloud(glm::vec3 const &color) {
+
+    Cloud cloud;
+    cloud.octree = nullptr;
+    cloud.color = color;
+    cloud.visible = true;
+
+    // the pointer gets set by every upload
+    glGenVertexArrays(1, &cloud.vertex_array_id);
+    glBindVertexArray(cloud.vertex_array_id);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    this->_clouds.push_back(cloud);
+    return (int) this->_clouds.size() - 1;
+}
+
+
+void PointCloud::upload(int cloud_idx, PointOctree const *octree) {
+    Cloud &cloud = this->_clouds[cloud_idx];
+    cloud.octree = octree;
+
+    std::vector<glm::vec3> const &points = octree->get_points();
+    GLintptr offset = this->_stream_buffers->write(points.data(), points.size() * sizeof(glm::vec3));
+
+    glBindVertexArray(cloud.vertex_array_id);
+    glBindBuffer(GL_ARRAY_BUFFER, this->_stream_buffers->get_buffer_id());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *) offset);
+    glBindVertexArray(0);
+}
+
+
+void PointCloud::set_visible(int cloud_idx, bool visible) {
+    this->_clouds[cloud_idx].visible = visible;
+}
+
+
+bool PointCloud::is_visible(int cloud_idx) const {
+    return this->_clouds[cloud_idx].visible;
+}
+
+
+unsigned long PointCloud::draw(glm::mat4 const &mvp, unsigned long point_budget, float point_size) {
+
+    unsigned long num_visible = 0;
+    for (auto const &cloud : this->_clouds) {
+        num_visible += cloud.visible && cloud.octree != nullptr ? 1 : 0;
+    }
+    if (num_visible == 0) {
+        return 0;
+    }
+
+    glUseProgram(this->_program_id);
+    glUniformMatrix4fv(this->_mvp_location, 1, GL_FALSE, &mvp[0][0]);
+    glUniform1f(this->_point_size_location, point_size);
+
+    unsigned long num_drawn = 0;
+    for (auto const &cloud : this->_clouds) {
+        if (!cloud.visible || cloud.octree == nullptr) {
+            continue;
+        }
+
+        num_drawn += cloud.octree->select(mvp, point_budget / num_visible, &this->_firsts, &this->_counts);
+        if (this->_firsts.empty()) {
+            continue;
+        }
+
+        glUniform3fv(this->_color_location, 1, &cloud.color[0]);
+        glBindVertexArray(cloud.vertex_array_id);
+        glMultiDrawArrays(GL_POINTS, this->_firsts.data(), this->_counts.data(), (GLsizei) this->_firsts.size());
+    }
+
+    glBindVertexArray(0);
+    return num_drawn;
+}
+
+
+void PointCloud::release() {
+    for (auto &cloud : this->_clouds) {
+        glDeleteVertexArrays(1, &cloud.vertex_array_id);
+    }
+    this->_clouds.clear();
+
+    if (this->_program_id != 0) {
+        glDeleteProgram(this->_program_id);
+        this->_program_id = 0;
+    }
+}
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+#include "PointOctree.hpp"
+
+// points that keep landing in the same box after this many splits stay in one node
+#define MAX_DEPTH 16
+
+/**
+ * c'tor
+ */
+PointOctree::PointOctree()
+        : _node_capacity(0) {}
+
+
+void PointOctree::build(ResultView<glm::vec3> const &points, unsigned int node_capacity) {
+
+    std::vector<unsigned int> indices(points.size());
+    for (unsigned int i = 0; i < indices.size(); ++i) {
+        indices[i] = i;
+    }
+    this->build(points, std::move(indices), node_capacity);
+}
+
+
+void PointOctree::build(ResultView<glm::vec3> const &points, std::vector<unsigned int> indices,
+                        unsigned int node_capacity) {
+
+    this->_points.clear();
+    this->_nodes.clear();
+    this->_node_capacity = std::max(node_capacity, 1u);
+    if (indices.empty()) {
+        return;
+    }
+
+    glm::vec3 box_min = points[indices[0]];
+    glm::vec3 box_max = points[indices[0]];
+    for (unsigned int idx : indices) {
+        box_min = glm::min(box_min, points[idx]);
+        box_max = glm::max(box_max, points[idx]);
+    }
+
+    // cubic boxes keep the children evenly shaped
+    glm::vec3 center = 0.5f * (box_min + box_max);
+    float half_size = 0.5f * std::max(std::max(box_max.x - box_min.x, box_max.y - box_min.y), box_max.z - box_min.z);
+    half_size = half_size * 1.001f + 1e-6f;
+
+    this->_points.reserve(indices.size());
+    this->buildNode(indices, center - glm::vec3(half_size), center + glm::vec3(half_size), 0, points);
+}
+
+
+int PointOctree::buildNode(std::vector<unsigned int> &indices, glm::vec3 const &box_min, glm::vec3 const &box_max,
+                           int depth, ResultView<glm::vec3> const &source) {
+
+    int node_idx = (int) this->_nodes.size();
+    Node node;
+    node.box_min = box_min;
+    node.box_max = box_max;
+    node.first = (unsigned int) this->_points.size();
+    node.count = 0;
+    std::fill(node.children, node.children + 8, -1);
+    this->_nodes.push_back(node);
+
+    if (indices.size() <= this->_node_capacity || depth >= MAX_DEPTH) {
+        for (unsigned int idx : indices) {
+            this->_points.push_back(source[idx]);
+        }
+        this->_nodes[node_idx].count = (unsigned int) indices.size();
+        return node_idx;
+    }
+
+    // keep the first point of every cell of a regular grid over the box,
+    // which spreads the sample evenly no matter how dense the points are
+    int resolution = std::max((int) std::cbrt((double) this->_node_capacity), 1);
+    std::vector<bool> occupied((unsigned long) (resolution * resolution * resolution), false);
+    glm::vec3 cell_scale = float(resolution) / (box_max - box_min);
+    glm::vec3 center = 0.5f * (box_min + box_max);
+
+    std::vector<unsigned int> octants[8];
+    unsigned int num_kept = 0;
+    for (unsigned int idx : indices) {
+        glm::vec3 const &point = source[idx];
+
+        glm::vec3 cell = (point - box_min) * cell_scale;
+        int x = std::min(std::max((int) cell.x, 0), resolution - 1);
+        int y = std::min(std::max((int) cell.y, 0), resolution - 1);
+        int z = std::min(std::max((int) cell.z, 0), resolution - 1);
+        unsigned long cell_idx = (unsigned long) ((z * resolution + y) * resolution + x);
+
+        if (!occupied[cell_idx] && num_kept < this->_node_capacity) {
+            occupied[cell_idx] = true;
+            this->_points.push_back(point);
+            ++num_kept;
+        } else {
+            int octant = (point.x >= center.x ? 1 : 0) | (point.y >= center.y ? 2 : 0) | (point.z >= center.z ? 4 : 0);
+            octants[octant].push_back(idx);
+        }
+    }
+    this->_nodes[node_idx].count = num_kept;
+
+    // children only need the index lists of their own octant
+    std::vector<unsigned int>().swap(indices);
+
+    for (int octant = 0; octant < 8; ++octant) {
+        if (octants[octant].empty()) {
+            continue;
+        }
+        glm::vec3 child_min(octant & 1 ? center.x : box_min.x,
+                            octant & 2 ? center.y : box_min.y,
+                            octant & 4 ? center.z : box_min.z);
+        glm::vec3 child_max(octant & 1 ? box_max.x : center.x,
+                            octant & 2 ? box_max.y : center.y,
+                            octant & 4 ? box_max.z : center.z);
+        int child_idx = this->buildNode(octants[octant], child_min, child_max, depth + 1, source);
+        this->_nodes[node_idx].children[octant] = child_idx;
+    }
+
+    return node_idx;
+}
+
+
+/**
+ * Checks whether a box lies completely outside of one of the clip planes
+ * @param mvp
+ * @param box_min
+ * @param box_max
+ * @return
+ */
+static bool isCulled(glm::mat4 const &mvp, glm::vec3 const &box_min, glm::vec3 const &box_max) {
+
+    // count the corners outside of every plane: -x, +x, -y, +y, -z, +z
+    int outside[6] = {0, 0, 0, 0, 0, 0};
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec4 clip = mvp * glm::vec4(corner & 1 ? box_max.x : box_min.x,
+                                         corner & 2 ? box_max.y : box_min.y,
+                                         corner & 4 ? box_max.z : box_min.z,
+                                         1.0f);
+        for (int axis = 0; axis < 3; ++axis) {
+            outside[axis * 2] += clip[axis] < -clip.w ? 1 : 0;
+            outside[axis * 2 + 1] += clip[axis] > clip.w ? 1 : 0;
+        }
+    }
+
+    for (int plane = 0; plane < 6; ++plane) {
+        if (outside[plane] == 8) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Approximates the projected size of a box by its bounding sphere
+ * @param mvp
+ * @param box_min
+ * @param box_max
+ * @return
+ */
+static float projectedSize(glm::mat4 const &mvp, glm::vec3 const &box_min, glm::vec3 const &box_max) {
+    glm::vec3 center = 0.5f * (box_min + box_max);
+    float radius = 0.5f * glm::length(box_max - box_min);
+    float distance = (mvp * glm::vec4(center, 1.0f)).w;
+
+    // boxes around the camera always come first
+    if (distance <= radius) {
+        return HUGE_VALF;
+    }
+    return radius / distance;
+}
+
+
+unsigned long PointOctree::select(glm::mat4 const &mvp, unsigned long point_budget,
+                                  std::vector<int> *firsts, std::vector<int> *counts) const {
+
+    firsts->clear();
+    counts->clear();
+    if (this->_nodes.empty()) {
+        return 0;
+    }
+
+    // largest projected size first, every picked node makes its children candidates
+    std::priority_queue<std::pair<float, int>> candidates;
+    Node const &root = this->_nodes[0];
+    if (!isCulled(mvp, root.box_min, root.box_max)) {
+        candidates.push(std::make_pair(projectedSize(mvp, root.box_min, root.box_max), 0));
+    }
+
+    unsigned long num_picked = 0;
+    while (!candidates.empty()) {
+        Node const &node = this->_nodes[candidates.top().second];
+        candidates.pop();
+
+        // children only add detail to what is already drawn, so stop at the first node exceeding the budget
+        if (num_picked + node.count > point_budget) {
+            break;
+        }
+        firsts->push_back((int) node.first);
+        counts->push_back((int) node.count);
+        num_picked += node.count;
+
+        for (int child_idx : node.children) {
+            if (child_idx < 0) {
+                continue;
+            }
+            Node const &child = this->_nodes[child_idx];
+            if (!isCulled(mvp, child.box_min, child.box_max)) {
+                candidates.push(std::make_pair(projectedSize(mvp, child.box_min, child.box_max), child_idx));
+            }
+        }
+    }
+
+    return num_picked;
+}
+
+
+std::vector<glm::vec3> const &PointOctree::get_points() const {
+    return this->_points;
+}
+
+
+std::vector<PointOctree::Node> const &PointOctree::get_nodes() const {
+    return this->_nodes;
+}
@@ -14,7 +14,12 @@
  */
 Ray::Ray()
         : origin(glm::vec3())
-        , direction(glm::vec3()) {}
+        , direction(glm::vec3())
+        , has_differentials(false)
+        , origin_dx(glm::vec3())
+        , origin_dy(glm::vec3())
+        , direction_dx(glm::vec3())
+        , direction_dy(glm::vec3()) {}
 
 /**
  * c'tor
@@ -22,7 +27,12 @@ Ray::Ray()
  */
 Ray::Ray(const glm::vec3 &origin)
         : origin(origin)
-        , direction(glm::vec3()) {}
+        , direction(glm::vec3())
+        , has_differentials(false)
+        , origin_dx(glm::vec3())
+        , origin_dy(glm::vec3())
+        , direction_dx(glm::vec3())
+        , direction_dy(glm::vec3()) {}
 
 /**
  * c'tor
@@ -31,7 +41,12 @@ Ray::Ray(const glm::vec3 &origin)
  */
 Ray::Ray(const glm::vec3 &origin, const glm::vec3 &direction)
         : origin(origin)
-        , direction(direction) {}
+        , direction(direction)
+        , has_differentials(false)
+        , origin_dx(glm::vec3())
+        , origin_dy(glm::vec3())
+        , direction_dx(glm::vec3())
+        , direction_dy(glm::vec3()) {}
 
 
 /**
@@ -40,7 +55,12 @@ Ray::Ray(const glm::vec3 &origin, const glm::vec3 &direction)
  */
 Ray::Ray(const Ray &ray)
         : origin(ray.origin)
-        , direction(ray.direction) {}
+        , direction(ray.direction)
+        , has_differentials(ray.has_differentials)
+        , origin_dx(ray.origin_dx)
+        , origin_dy(ray.origin_dy)
+        , direction_dx(ray.direction_dx)
+        , direction_dy(ray.direction_dy) {}
 
 /**
  * d'tor
@@ -48,6 +68,23 @@ Ray::Ray(const Ray &ray)
 Ray::~Ray() {}
 
 
+/**
+ * attach ray differentials
+ * @param origin_dx
+ * @param origin_dy
+ * @param direction_dx
+ * @param direction_dy
+ */
+void Ray::setDifferentials(glm::vec3 const &origin_dx, glm::vec3 const &origin_dy,
+                           glm::vec3 const &direction_dx, glm::vec3 const &direction_dy) {
+    this->has_differentials = true;
+    this->origin_dx = origin_dx;
+    this->origin_dy = origin_dy;
+    this->direction_dx = direction_dx;
+    this->direction_dy = direction_dy;
+}
+
+
 /**
  * reflect ray along given normal
  * @param normal
@@ -57,6 +94,30 @@ glm::vec3 Ray::reflect(glm::vec3 const &normal) const {
     return this->direction - 2.0f * (glm::dot(this->direction, glm::normalize(normal))) * glm::normalize(normal);
 }
 
+/**
+ * reflect ray at the given hitpoint
+ * @param hit
+ * @return
+ */
+Ray Ray::reflectAt(Hitpoint const &hit) const {
+
+    glm::vec3 const &n = hit.normal;
+    float d_dot_n = glm::dot(this->direction, n);
+    Ray reflected(hit.position, this->direction - 2.0f * d_dot_n * n);
+
+    if (this->has_differentials) {
+        // derivative of d - 2 (d.n) n, with both the direction and the normal varying
+        float dot_dx = glm::dot(this->direction_dx, n) + glm::dot(this->direction, hit.normal_dx);
+        float dot_dy = glm::dot(this->direction_dy, n) + glm::dot(this->direction, hit.normal_dy);
+        reflected.setDifferentials(hit.position_dx,
+                                   hit.position_dy,
+                                   this->direction_dx - 2.0f * (d_dot_n * hit.normal_dx + dot_dx * n),
+                                   this->direction_dy - 2.0f * (d_dot_n * hit.normal_dy + dot_dy * n));
+    }
+
+    return reflected;
+}
+
 /**
  * stream << output operator
  * @param os
@@ -2,50 +2,201 @@
 // Created by Hagen Hiller on 20/12/17.
 //
 
+#include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <vector>
 #include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "ShaderUtil.hpp"
 
+// marks the files written by the program cache
+#define PROGRAM_CACHE_MAGIC 0x42535052u
+
+// directory of the cached program binaries, empty while caching is off
+static std::string program_cache_directory;
+
+
+void SetProgramCacheDirectory(std::string const &directory) {
+    program_cache_directory = directory;
+    if (!directory.empty()) {
+        mkdir(directory.c_str(), 0755);
+    }
+}
+
+
+/**
+ * 64 bit FNV-1a, continuing from the given hash
+ * @param data
+ * @param hash
+ * @return
+ */
+static unsigned long long fnv1a(std::string const &data, unsigned long long hash) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+/**
+ * Names the cache file of a program. Binaries only work with the driver that
+ * wrote them, so the driver strings are part of the key.
+ * @param vertex_code
+ * @param fragment_code
+ * @return empty if caching is not possible
+ */
+static std::string programCachePath(std::string const &vertex_code, std::string const &fragment_code) {
+
+    if (program_cache_directory.empty() || !GLEW_ARB_get_program_binary) {
+        return std::string();
+    }
+
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    if (num_formats <= 0) {
+        return std::string();
+    }
+
+    unsigned long long hash = 14695981039346656037ull;
+    hash = fnv1a(vertex_code, hash);
+    hash = fnv1a(std::string(1, '\0'), hash);
+    hash = fnv1a(fragment_code, hash);
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        char const *value = (char const *) glGetString(name);
+        hash = fnv1a(std::string(1, '\0') + (value != nullptr ? value : ""), hash);
+    }
+
+    char file_name[32];
+    snprintf(file_name, sizeof(file_name), "%016llx.bin", hash);
+    return program_cache_directory + "/" + file_name;
+}
+
+
+/**
+ * Creates a program from a cached binary
+ * @param cache_path
+ * @return 0 if the binary is missing or the driver rejected it
+ */
+static GLuint loadCachedProgram(std::string const &cache_path) {
+
+    std::ifstream ifs(cache_path, std::ios::binary);
+    if (!ifs.good()) {
+        return 0;
+    }
+
+    unsigned int magic = 0;
+    GLenum format = 0;
+    ifs.read((char *) &magic, sizeof(magic));
+    ifs.read((char *) &format, sizeof(format));
+    std::vector<char> binary((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    if (magic != PROGRAM_CACHE_MAGIC || binary.empty()) {
+        return 0;
+    }
+
+    GLuint ProgramID = glCreateProgram();
+    glProgramBinary(ProgramID, format, binary.data(), (GLsizei) binary.size());
+
+    GLint Result = GL_FALSE;
+    glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+    if (Result != GL_TRUE) {
+        glDeleteProgram(ProgramID);
+        return 0;
+    }
+    return ProgramID;
+}
+
 
 /**
- * load shaders from give filepaths
+ * Writes the binary of a linked program to the cache
+ * @param cache_path
+ * @param ProgramID
+ */
+static void storeCachedProgram(std::string const &cache_path, GLuint ProgramID) {
+
+    GLint length = 0;
+    glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary((unsigned long) length);
+    GLenum format = 0;
+    glGetProgramBinary(ProgramID, length, nullptr, &format, binary.data());
+
+    // every writer fills its own temporary file, so concurrent launches each rename a whole binary into place
+    std::string temp_template = cache_path + ".XXXXXX";
+    std::vector<char> temp_path(temp_template.begin(), temp_template.end());
+    temp_path.push_back('\0');
+    int fd = mkstemp(temp_path.data());
+    if (fd < 0) {
+        printf("Failed to cache program : %s\n", cache_path.c_str());
+        return;
+    }
+    fchmod(fd, 0644);
+
+    FILE *file = fdopen(fd, "wb");
+    if (file == nullptr) {
+        close(fd);
+        remove(temp_path.data());
+        printf("Failed to cache program : %s\n", cache_path.c_str());
+        return;
+    }
+    unsigned int magic = PROGRAM_CACHE_MAGIC;
+    bool written = fwrite(&magic, sizeof(magic), 1, file) == 1 &&
+                   fwrite(&format, sizeof(format), 1, file) == 1 &&
+                   fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+    written = fclose(file) == 0 && written;
+
+    if (!written || rename(temp_path.data(), cache_path.c_str()) != 0) {
+        printf("Failed to cache program : %s\n", cache_path.c_str());
+        remove(temp_path.data());
+    }
+}
+
+
+/**
+ * load shaders from give filepaths, linked programs come from the program cache when possible
  * @param vertex_file_path
  * @param fragment_file_path
  * @return
  */
 GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path) {
 
-    // Create the shaders
-    GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-    GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
     // Read the Vertex Shader code from the file
-    std::string VertexShaderCode;
     std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-    if (VertexShaderStream.is_open()) {
-        std::string Line = "";
-        while (getline(VertexShaderStream, Line))
-            VertexShaderCode += "\n" + Line;
-        VertexShaderStream.close();
-    } else {
+    if (!VertexShaderStream.is_open()) {
         printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n",
                vertex_file_path);
         getchar();
         return 0;
     }
+    std::string VertexShaderCode((std::istreambuf_iterator<char>(VertexShaderStream)),
+                                 std::istreambuf_iterator<char>());
 
     // Read the Fragment Shader code from the file
-    std::string FragmentShaderCode;
     std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-    if (FragmentShaderStream.is_open()) {
-        std::string Line = "";
-        while (getline(FragmentShaderStream, Line))
-            FragmentShaderCode += "\n" + Line;
-        FragmentShaderStream.close();
+    std::string FragmentShaderCode((std::istreambuf_iterator<char>(FragmentShaderStream)),
+                                   std::istreambuf_iterator<char>());
+
+    // Skip compiling if the driver accepts a binary of the same sources
+    std::string CachePath = programCachePath(VertexShaderCode, FragmentShaderCode);
+    if (!CachePath.empty()) {
+        GLuint CachedProgramID = loadCachedProgram(CachePath);
+        if (CachedProgramID != 0) {
+            printf("Loaded cached program : %s %s\n", vertex_file_path, fragment_file_path);
+            return CachedProgramID;
+        }
     }
 
+    // Create the shaders
+    GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+    GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
     GLint Result = GL_FALSE;
     int InfoLogLength;
 
@@ -89,6 +240,9 @@ GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path)
     GLuint ProgramID = glCreateProgram();
     glAttachShader(ProgramID, VertexShaderID);
     glAttachShader(ProgramID, FragmentShaderID);
+    if (!CachePath.empty()) {
+        glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(ProgramID);
 
     // Check the program
@@ -107,5 +261,9 @@ GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path)
     glDeleteShader(VertexShaderID);
     glDeleteShader(FragmentShaderID);
 
+    if (!CachePath.empty() && Result == GL_TRUE) {
+        storeCachedProgram(CachePath, ProgramID);
+    }
+
     return ProgramID;
 }
@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "SharedMesh.hpp"
+
+// identifies a warp mesh region, followed by the layout version
+#define SHARED_MESH_MAGIC 0x4853454Du
+#define SHARED_MESH_VERSION 2u
+
+// headers and buffers start on their own cache line
+#define SHARED_MESH_ALIGNMENT 64ul
+
+// attempts of a reader on a slot the publisher is writing, it yields in between
+#define SHARED_MESH_MAX_RETRIES 10000
+
+static unsigned long alignUp(unsigned long bytes) {
+    return (bytes + SHARED_MESH_ALIGNMENT - 1) / SHARED_MESH_ALIGNMENT * SHARED_MESH_ALIGNMENT;
+}
+
+static unsigned long headerBytes() {
+    return alignUp(sizeof(SharedMeshHeader));
+}
+
+static unsigned long slotHeaderBytes() {
+    return alignUp(sizeof(SharedMeshSlot));
+}
+
+static unsigned long vertexBytes(unsigned long num_vertices) {
+    return num_vertices * DomeMesh::FLOATS_PER_VERTEX * sizeof(float);
+}
+
+/**
+ * Start of the given slot within the region
+ * @param region
+ * @param slot_idx
+ * @return
+ */
+static char *slotAddress(void const *region, uint32_t slot_idx) {
+    SharedMeshHeader const *header = (SharedMeshHeader const *) region;
+    return (char *) region + headerBytes() + (unsigned long) slot_idx * header->slot_bytes;
+}
+
+#ifdef __linux__
+/**
+ * Thin wrapper of the futex syscall on a word shared between processes
+ * @param word
+ * @param op
+ * @param value
+ * @param timeout
+ * @return
+ */
+static long futex(std::atomic<uint32_t> const *word, int op, uint32_t value, timespec const *timeout) {
+    return syscall(SYS_futex, (uint32_t const *) word, op, value, timeout, nullptr, 0);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// PUBLISHER
+// ---------------------------------------------------------------------------
+
+/**
+ * c'tor
+ */
+SharedMeshPublisher::SharedMeshPublisher()
+        : _region(nullptr)
+        , _region_bytes(0)
+        , _frame(0) {}
+
+
+SharedMeshPublisher::~SharedMeshPublisher() {
+    this->close();
+}
+
+
+bool SharedMeshPublisher::open(std::string const &name, int num_slots,
+                               unsigned long max_vertices, unsigned long max_indices) {
+#ifdef __linux__
+    this->close();
+
+    if (num_slots < 2 || max_vertices == 0 || max_indices == 0) {
+        std::cout << "invalid shared mesh layout for '" << name << "'" << std::endl;
+        return false;
+    }
+
+    unsigned long slot_bytes = slotHeaderBytes() + alignUp(vertexBytes(max_vertices)) +
+                               alignUp(max_indices * sizeof(unsigned int));
+    if (slot_bytes > UINT32_MAX) {
+        std::cout << "shared mesh slots of '" << name << "' exceed 4 GiB" << std::endl;
+        return false;
+    }
+    unsigned long region_bytes = headerBytes() + num_slots * slot_bytes;
+
+    // start from scratch, readers of an old region keep their mapping until they reopen
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cout << "failed to create shared memory '" << name << "': " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, (off_t) region_bytes) != 0) {
+        std::cout << "failed to size shared memory '" << name << "': " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    void *region = mmap(nullptr, region_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (region == MAP_FAILED) {
+        std::cout << "failed to map shared memory '" << name << "': " << std::strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // fresh pages are zeroed, so all sequences start even and nothing is published
+    SharedMeshHeader *header = (SharedMeshHeader *) region;
+    header->num_slots = (uint32_t) num_slots;
+    header->slot_bytes = (uint32_t) slot_bytes;
+    header->max_vertices = (uint32_t) max_vertices;
+    header->max_indices = (uint32_t) max_indices;
+    header->version = SHARED_MESH_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHARED_MESH_MAGIC;
+
+    this->_name = name;
+    this->_region = region;
+    this->_region_bytes = region_bytes;
+    this->_frame = 0;
+    return true;
+#else
+    std::cout << "shared mesh publishing is only available on linux" << std::endl;
+    return false;
+#endif
+}
+
+
+void SharedMeshPublisher::close() {
+#ifdef __linux__
+    if (this->_region != nullptr) {
+        // readers keep their mapping after the unlink, so tell them first
+        SharedMeshHeader *header = (SharedMeshHeader *) this->_region;
+        header->closed.store(1, std::memory_order_release);
+        header->notify.fetch_add(1, std::memory_order_release);
+        futex(&header->notify, FUTEX_WAKE, INT_MAX, nullptr);
+
+        munmap(this->_region, this->_region_bytes);
+        shm_unlink(this->_name.c_str());
+    }
+#endif
+    this->_region = nullptr;
+    this->_region_bytes = 0;
+}
+
+
+bool SharedMeshPublisher::publish(DomeMesh const &mesh) {
+#ifdef __linux__
+    if (this->_region == nullptr) {
+        return false;
+    }
+
+    SharedMeshHeader *header = (SharedMeshHeader *) this->_region;
+    if (mesh.numVertices() > header->max_vertices || mesh.numIndices() > header->max_indices) {
+        std::cout << "mesh of " << mesh.numVertices() << " vertices and " << mesh.numIndices()
+                  << " indices exceeds the shared memory capacity" << std::endl;
+        return false;
+    }
+
+    // the slot after the latest one is the one readers are least likely to be in
+    uint32_t slot_idx = (header->latest_slot.load(std::memory_order_relaxed) + 1) % header->num_slots;
+    char *slot_address = slotAddress(this->_region, slot_idx);
+    SharedMeshSlot *slot = (SharedMeshSlot *) slot_address;
+
+    uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->index_bytes = mesh.is16Bit() ? sizeof(unsigned short) : sizeof(unsigned int);
+    slot->num_vertices = (uint32_t) mesh.numVertices();
+    slot->num_indices = (uint32_t) mesh.numIndices();
+    slot->frame = ++this->_frame;
+
+    char *vertices = slot_address + slotHeaderBytes();
+    std::memcpy(vertices, mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+    std::memcpy(vertices + alignUp(vertexBytes(header->max_vertices)), mesh.indexData(), mesh.indexBytes());
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    header->latest_slot.store(slot_idx, std::memory_order_release);
+
+    header->notify.fetch_add(1, std::memory_order_release);
+    futex(&header->notify, FUTEX_WAKE, INT_MAX, nullptr);
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+bool SharedMeshPublisher::is_open() const {
+    return this->_region != nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// SUBSCRIBER
+// ---------------------------------------------------------------------------
+
+/**
+ * c'tor
+ */
+SharedMeshSubscriber::SharedMeshSubscriber()
+        : _region(nullptr)
+        , _region_bytes(0) {}
+
+
+SharedMeshSubscriber::~SharedMeshSubscriber() {
+    this->close();
+}
+
+
+bool SharedMeshSubscriber::open(std::string const &name) {
+#ifdef __linux__
+    this->close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (unsigned long) info.st_size < headerBytes()) {
+        ::close(fd);
+        return false;
+    }
+
+    void *region = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (region == MAP_FAILED) {
+        return false;
+    }
+
+    // the publisher writes the magic last, so a matching magic means a complete header
+    SharedMeshHeader const *header = (SharedMeshHeader const *) region;
+    bool valid = header->magic == SHARED_MESH_MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid = valid && header->version == SHARED_MESH_VERSION &&
+            headerBytes() + (unsigned long) header->num_slots * header->slot_bytes <= (unsigned long) info.st_size;
+    if (!valid) {
+        munmap(region, (size_t) info.st_size);
+        return false;
+    }
+
+    this->_region = region;
+    this->_region_bytes = (unsigned long) info.st_size;
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void SharedMeshSubscriber::close() {
+#ifdef __linux__
+    if (this->_region != nullptr) {
+        munmap((void *) this->_region, this->_region_bytes);
+    }
+#endif
+    this->_region = nullptr;
+    this->_region_bytes = 0;
+}
+
+
+bool SharedMeshSubscriber::wait(uint32_t last_notify, int timeout_ms) const {
+#ifdef __linux__
+    if (this->_region == nullptr) {
+        return false;
+    }
+
+    SharedMeshHeader const *header = (SharedMeshHeader const *) this->_region;
+    timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+    // the kernel only sleeps while the word still holds the old count, so no wake up gets lost
+    while (header->notify.load(std::memory_order_acquire) == last_notify) {
+        if (futex(&header->notify, FUTEX_WAIT, last_notify, &timeout) != 0 && errno == ETIMEDOUT) {
+            return header->notify.load(std::memory_order_acquire) != last_notify;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+bool SharedMeshSubscriber::acquire(SharedMeshView *view, uint32_t *notify) const {
+    if (this->_region == nullptr) {
+        return false;
+    }
+
+    SharedMeshHeader const *header = (SharedMeshHeader const *) this->_region;
+    unsigned long index_offset = slotHeaderBytes() + alignUp(vertexBytes(header->max_vertices));
+
+    // a publisher that died while writing leaves the sequence odd for good
+    for (int attempt = 0; attempt < SHARED_MESH_MAX_RETRIES; ++attempt) {
+        if (attempt > 0) {
+            std::this_thread::yield();
+        }
+
+        uint32_t notify_count = header->notify.load(std::memory_order_acquire);
+        *notify = notify_count;
+        uint32_t slot_idx = header->latest_slot.load(std::memory_order_acquire);
+        char const *slot_address = slotAddress(this->_region, slot_idx);
+        SharedMeshSlot const *slot = (SharedMeshSlot const *) slot_address;
+
+        uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence % 2 != 0) {
+            continue;
+        }
+
+        // the slot header has to be consistent by itself, the payload gets validated by the caller
+        uint32_t index_bytes = slot->index_bytes;
+        uint32_t num_vertices = std::min(slot->num_vertices, header->max_vertices);
+        uint32_t num_indices = std::min(slot->num_indices, header->max_indices);
+        uint64_t slot_frame = slot->frame;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+
+        // frames count from one and never wrap, an untouched slot still holds frame zero
+        if (slot_frame == 0) {
+            return false;
+        }
+
+        view->vertices = (float const *) (slot_address + slotHeaderBytes());
+        view->indices = slot_address + index_offset;
+        view->index_bytes = index_bytes == sizeof(unsigned short) ? sizeof(unsigned short) : sizeof(unsigned int);
+        view->num_vertices = num_vertices;
+        view->num_indices = num_indices;
+        view->frame = slot_frame;
+        view->slot = slot_idx;
+        view->sequence = sequence;
+        return true;
+    }
+    return false;
+}
+
+
+bool SharedMeshSubscriber::validate(SharedMeshView const &view) const {
+    if (this->_region == nullptr) {
+        return false;
+    }
+
+    SharedMeshSlot const *slot = (SharedMeshSlot const *) slotAddress(this->_region, view.slot);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+
+bool SharedMeshSubscriber::read(DomeMesh *mesh, uint64_t *frame, uint32_t *notify) const {
+
+    // copy first and validate afterwards, a changed sequence means the publisher got in between
+    SharedMeshView view;
+    while (this->acquire(&view, notify)) {
+        mesh->vertices.resize((unsigned long) view.num_vertices * DomeMesh::FLOATS_PER_VERTEX);
+        std::memcpy(mesh->vertices.data(), view.vertices, vertexBytes(view.num_vertices));
+        if (view.index_bytes == sizeof(unsigned short)) {
+            mesh->indices32.clear();
+            mesh->indices16.resize(view.num_indices);
+            std::memcpy(mesh->indices16.data(), view.indices, view.num_indices * sizeof(unsigned short));
+        } else {
+            mesh->indices16.clear();
+            mesh->indices32.resize(view.num_indices);
+            std::memcpy(mesh->indices32.data(), view.indices, view.num_indices * sizeof(unsigned int));
+        }
+
+        if (this->validate(view)) {
+            *frame = view.frame;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool SharedMeshSubscriber::is_closed() const {
+    if (this->_region == nullptr) {
+        return false;
+    }
+    SharedMeshHeader const *header = (SharedMeshHeader const *) this->_region;
+    return header->closed.load(std::memory_order_acquire) != 0;
+}
+
+
+bool SharedMeshSubscriber::is_open() const {
+    return this->_region != nullptr;
+}
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "SpatialGrid.hpp"
+
+/**
+ * c'tor
+ */
+SpatialGrid::SpatialGrid()
+        : _min(glm::vec3())
+        , _max(glm::vec3())
+        , _cell_size(glm::vec3(1.0f))
+        , _cells_per_axis(0) {}
+
+
+void SpatialGrid::build(std::vector<glm::vec3> const &box_min,
+                        std::vector<glm::vec3> const &box_max,
+                        int cells_per_axis) {
+
+    _offsets.clear();
+    _indices.clear();
+    _cells_per_axis = 0;
+
+    if (box_min.empty()) {
+        return;
+    }
+
+    _cells_per_axis = std::max(cells_per_axis, 1);
+    _min = box_min[0];
+    _max = box_max[0];
+    for (unsigned long i = 1; i < box_min.size(); ++i) {
+        _min = glm::min(_min, box_min[i]);
+        _max = glm::max(_max, box_max[i]);
+    }
+
+    // avoid degenerated cells for flat point sets
+    _cell_size = glm::max((_max - _min) / (float) _cells_per_axis, glm::vec3(std::numeric_limits<float>::epsilon()));
+
+    int num_cells = _cells_per_axis * _cells_per_axis * _cells_per_axis;
+    _offsets.assign((unsigned long) num_cells + 1, 0);
+
+    // first pass counts the references of each cell, the second one fills them in
+    for (int pass = 0; pass < 2; ++pass) {
+        for (unsigned long i = 0; i < box_min.size(); ++i) {
+            glm::vec3 lo = cellCoord(box_min[i]);
+            glm::vec3 hi = cellCoord(box_max[i]);
+
+            for (int z = (int) lo.z; z <= (int) hi.z; ++z) {
+                for (int y = (int) lo.y; y <= (int) hi.y; ++y) {
+                    for (int x = (int) lo.x; x <= (int) hi.x; ++x) {
+                        int cell = cellIndex(x, y, z);
+                        if (pass == 0) {
+                            ++_offsets[cell + 1];
+                        } else {
+                            _indices[_offsets[cell]++] = (int) i;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (int cell = 0; cell < num_cells; ++cell) {
+                _offsets[cell + 1] += _offsets[cell];
+            }
+            _indices.resize((unsigned long) _offsets[num_cells]);
+        }
+    }
+
+    // the fill pass advanced each offset to the begin of the next cell
+    std::copy_backward(_offsets.begin(), _offsets.end() - 1, _offsets.end());
+    _offsets[0] = 0;
+}
+
+
+void SpatialGrid::query(glm::vec3 const &point, int const **begin, int const **end) const {
+    *begin = nullptr;
+    *end = nullptr;
+
+    if (empty() ||
+        point.x < _min.x || point.y < _min.y || point.z < _min.z ||
+        point.x > _max.x || point.y > _max.y || point.z > _max.z) {
+        return;
+    }
+
+    glm::vec3 coord = cellCoord(point);
+    int cell = cellIndex((int) coord.x, (int) coord.y, (int) coord.z);
+    *begin = _indices.data() + _offsets[cell];
+    *end = _indices.data() + _offsets[cell + 1];
+}
+
+
+void SpatialGrid::query(glm::vec3 const &box_min, glm::vec3 const &box_max, std::vector<int> *result) const {
+    result->clear();
+
+    if (empty() ||
+        box_max.x < _min.x || box_max.y < _min.y || box_max.z < _min.z ||
+        box_min.x > _max.x || box_min.y > _max.y || box_min.z > _max.z) {
+        return;
+    }
+
+    glm::vec3 lo = cellCoord(box_min);
+    glm::vec3 hi = cellCoord(box_max);
+    for (int z = (int) lo.z; z <= (int) hi.z; ++z) {
+        for (int y = (int) lo.y; y <= (int) hi.y; ++y) {
+            for (int x = (int) lo.x; x <= (int) hi.x; ++x) {
+                int cell = cellIndex(x, y, z);
+                result->insert(result->end(), _indices.begin() + _offsets[cell], _indices.begin() + _offsets[cell + 1]);
+            }
+        }
+    }
+}
+
+
+bool SpatialGrid::empty() const {
+    return _indices.empty();
+}
+
+
+glm::vec3 SpatialGrid::cellCoord(glm::vec3 const &point) const {
+    glm::vec3 coord = (point - _min) / _cell_size;
+    float last = (float) (_cells_per_axis - 1);
+    return glm::vec3(std::floor(glm::clamp(coord.x, 0.0f, last)),
+                     std::floor(glm::clamp(coord.y, 0.0f, last)),
+                     std::floor(glm::clamp(coord.z, 0.0f, last)));
+}
+
+
+int SpatialGrid::cellIndex(int x, int y, int z) const {
+    return (z * _cells_per_axis + y) * _cells_per_axis + x;
+}
@@ -1,6 +1,8 @@
 //
 // Created by Hagen Hiller on 18/12/17.
 //
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <glm/glm.hpp>
 
@@ -102,10 +104,143 @@ bool Sphere::intersect(Ray const &r, std::pair<Hitpoint, Hitpoint> *hp_pair) {
     hp_pair->second.position = P2;
     hp_pair->second.normal = N2;
 
+    if (r.has_differentials) {
+        this->transferDifferentials(r, &hp_pair->first, (float) t_0);
+        this->transferDifferentials(r, &hp_pair->second, (float) t_1);
+    }
+
+    return true;
+}
+
+
+/**
+ * Finds the closest hit in front of the ray origin.
+ * @param r
+ * @param hit
+ * @return bool success
+ */
+bool Sphere::intersectNear(Ray const &r, Hitpoint *hit) const {
+
+    float t_near;
+    float t_far;
+    if (!this->solve(r, &t_near, &t_far) || t_far <= epsilon) {
+        return false;
+    }
+
+    // an origin inside the sphere has the near crossing behind it
+    this->fillHit(r, t_near > epsilon ? t_near : t_far, hit);
+    return true;
+}
+
+
+/**
+ * Finds the furthest hit in front of the ray origin.
+ * @param r
+ * @param hit
+ * @return bool success
+ */
+bool Sphere::intersectFar(Ray const &r, Hitpoint *hit) const {
+
+    float t_near;
+    float t_far;
+    if (!this->solve(r, &t_near, &t_far) || t_far <= epsilon) {
+        return false;
+    }
+
+    this->fillHit(r, t_far, hit);
+    return true;
+}
+
+
+/**
+ * Checks whether the sphere blocks the ray before max_t without computing the hit.
+ * @param r
+ * @param max_t
+ * @return
+ */
+bool Sphere::occludes(Ray const &r, float max_t) const {
+
+    float t_near;
+    float t_far;
+    if (!this->solve(r, &t_near, &t_far)) {
+        return false;
+    }
+    return t_far > epsilon && (t_near > epsilon ? t_near : t_far) < max_t;
+}
+
+
+/**
+ * Solves |o + t d - c|^2 = r^2 in the form that avoids cancellation:
+ * q = -(b + sign(b) sqrt(b^2 - a c)) gives t = q / a and t = c / q.
+ * @param r
+ * @param t_near
+ * @param t_far
+ * @return
+ */
+bool Sphere::solve(Ray const &r, float *t_near, float *t_far) const {
+
+    glm::vec3 offset = r.origin - this->_center;
+    float a = glm::dot(r.direction, r.direction);
+    float half_b = glm::dot(r.direction, offset);
+    float c = glm::dot(offset, offset) - this->_radius * this->_radius;
+
+    float discriminant = half_b * half_b - a * c;
+    if (discriminant < 0.0f || a == 0.0f) {
+        return false;
+    }
+
+    float q = -(half_b + std::copysign(std::sqrt(discriminant), half_b));
+    float t_0 = q / a;
+    float t_1 = q != 0.0f ? c / q : t_0;
+
+    *t_near = std::min(t_0, t_1);
+    *t_far = std::max(t_0, t_1);
     return true;
 }
 
 
+/**
+ * Places the hit at distance t, its normal points away from the center
+ * @param r
+ * @param t
+ * @param hit
+ */
+void Sphere::fillHit(Ray const &r, float t, Hitpoint *hit) const {
+
+    hit->position = r.origin + t * r.direction;
+    hit->normal = (hit->position - this->_center) * (1.0f / this->_radius);
+    hit->t = t;
+
+    if (r.has_differentials) {
+        this->transferDifferentials(r, hit, t);
+    }
+}
+
+
+/**
+ * Transfers the rays differentials to the surface, see Igehy: Tracing Ray Differentials.
+ * @param r
+ * @param hit
+ * @param t
+ */
+void Sphere::transferDifferentials(Ray const &r, Hitpoint *hit, float t) const {
+
+    // the neighbouring rays travel until they meet the tangent plane
+    glm::vec3 offset_dx = r.origin_dx + t * r.direction_dx;
+    glm::vec3 offset_dy = r.origin_dy + t * r.direction_dy;
+    float d_dot_n = glm::dot(r.direction, hit->normal);
+    float t_dx = -glm::dot(offset_dx, hit->normal) / d_dot_n;
+    float t_dy = -glm::dot(offset_dy, hit->normal) / d_dot_n;
+
+    hit->position_dx = offset_dx + t_dx * r.direction;
+    hit->position_dy = offset_dy + t_dy * r.direction;
+
+    // the normal of a sphere turns with the position
+    hit->normal_dx = hit->position_dx / this->_radius;
+    hit->normal_dy = hit->position_dy / this->_radius;
+}
+
+
 
 // -----------------------------------------------------------------------------------------
 // GETTER
@@ -116,3 +116,22 @@ glm::vec3 utility::findMaxValues(std::vector<glm::vec3> vector) {
     return glm::vec3(smallest_x, smallest_y, smallest_z);
 
 }
+
+
+/**
+ * Van der Corput radical inverse of an index
+ * @param index
+ * @param base
+ * @return
+ */
+float utility::radicalInverse(unsigned int index, unsigned int base) {
+    float inverse_base = 1.0f / base;
+    float factor = inverse_base;
+    float result = 0.0f;
+    while (index > 0) {
+        result += (index % base) * factor;
+        index /= base;
+        factor *= inverse_base;
+    }
+    return result;
+}
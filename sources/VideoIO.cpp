@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "VideoIO.hpp"
+
+// large stdio buffers, frames are written in one piece anyway
+#define STREAM_BUFFER_SIZE (1 << 20)
+
+namespace video {
+
+    static inline unsigned char clampByte(int value) {
+        return (unsigned char) std::min(std::max(value, 0), 255);
+    }
+
+    /**
+     * BT.601 limited range to rgb, 16 bit fixed point
+     */
+    static inline void yuvToRgb(int y, int u, int v, unsigned char *rgb) {
+        int c = (y - 16) * 76309;
+        int d = u - 128;
+        int e = v - 128;
+        rgb[0] = clampByte((c + 104597 * e + 32768) >> 16);
+        rgb[1] = clampByte((c - 25675 * d - 53279 * e + 32768) >> 16);
+        rgb[2] = clampByte((c + 132201 * d + 32768) >> 16);
+    }
+
+    /**
+     * rgb to BT.601 limited range, 16 bit fixed point
+     */
+    static inline void rgbToYuv(unsigned char const *rgb, unsigned char *y, unsigned char *u, unsigned char *v) {
+        int r = rgb[0], g = rgb[1], b = rgb[2];
+        *y = clampByte(((16829 * r + 33039 * g + 6416 * b + 32768) >> 16) + 16);
+        *u = clampByte(((-9714 * r - 19071 * g + 28784 * b + 32768) >> 16) + 128);
+        *v = clampByte(((28784 * r - 24103 * g - 4681 * b + 32768) >> 16) + 128);
+    }
+
+    static FILE *openStream(std::string const &path, bool for_writing) {
+        if (path == "-") {
+            return for_writing ? stdout : stdin;
+        }
+        return fopen(path.c_str(), for_writing ? "wb" : "rb");
+    }
+
+    static void closeStream(FILE *file) {
+        if (file == nullptr) {
+            return;
+        }
+        if (file == stdin || file == stdout) {
+            fflush(file);
+        } else {
+            fclose(file);
+        }
+    }
+
+    /**
+     * Reads a header line up to the newline
+     * @param file
+     * @param line
+     * @return false at the end of the stream
+     */
+    static bool readLine(FILE *file, std::string *line) {
+        line->clear();
+        int c;
+        while ((c = fgetc(file)) != EOF && c != '\n') {
+            line->push_back((char) c);
+        }
+        return c == '\n';
+    }
+
+
+    /**
+     * c'tor
+     */
+    Reader::Reader()
+            : _file(nullptr)
+            , _format(RAW_RGB)
+            , _width(0)
+            , _height(0)
+            , _chroma_420(false)
+            , _frame_rate("30:1") {}
+
+
+    Reader::~Reader() {
+        this->close();
+    }
+
+
+    bool Reader::open(std::string const &path) {
+        this->close();
+        this->_file = openStream(path, false);
+        if (this->_file == nullptr) {
+            std::cout << "failed to open '" << path << "'" << std::endl;
+            return false;
+        }
+        setvbuf(this->_file, nullptr, _IOFBF, STREAM_BUFFER_SIZE);
+        return true;
+    }
+
+
+    bool Reader::openY4m(std::string const &path) {
+
+        if (!this->open(path)) {
+            return false;
+        }
+        this->_format = Y4M;
+
+        std::string header;
+        if (!readLine(this->_file, &header) || header.compare(0, 9, "YUV4MPEG2") != 0) {
+            std::cout << "'" << path << "' is no y4m stream" << std::endl;
+            return false;
+        }
+
+        // 4:2:0 is the default when the header does not name the chroma layout
+        this->_chroma_420 = true;
+        std::stringstream ss(header.substr(9));
+        std::string param;
+        while (ss >> param) {
+            if (param[0] == 'W') {
+                this->_width = std::atoi(param.c_str() + 1);
+            } else if (param[0] == 'H') {
+                this->_height = std::atoi(param.c_str() + 1);
+            } else if (param[0] == 'F') {
+                this->_frame_rate = param.substr(1);
+            } else if (param[0] == 'C') {
+                std::string chroma = param.substr(1);
+                if (chroma.compare(0, 3, "444") == 0 && chroma.find("alpha") == std::string::npos) {
+                    this->_chroma_420 = false;
+                } else if (chroma.compare(0, 3, "420") != 0) {
+                    std::cout << "unsupported y4m chroma '" << chroma << "'" << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        if (this->_width <= 0 || this->_height <= 0) {
+            std::cout << "y4m header without frame size" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+
+    bool Reader::openRaw(std::string const &path, int width, int height) {
+        if (!this->open(path)) {
+            return false;
+        }
+        this->_format = RAW_RGB;
+        this->_width = width;
+        this->_height = height;
+        return true;
+    }
+
+
+    bool Reader::read(std::vector<unsigned char> *packet) {
+
+        if (this->_file == nullptr) {
+            return false;
+        }
+
+        unsigned long frame_size = (unsigned long) this->_width * this->_height * Image::CHANNELS;
+        if (this->_format == Y4M) {
+            std::string frame_header;
+            if (!readLine(this->_file, &frame_header) || frame_header.compare(0, 5, "FRAME") != 0) {
+                return false;
+            }
+
+            unsigned long chroma_size = this->_chroma_420
+                                        ? (unsigned long) ((this->_width + 1) / 2) * ((this->_height + 1) / 2)
+                                        : (unsigned long) this->_width * this->_height;
+            frame_size = (unsigned long) this->_width * this->_height + 2 * chroma_size;
+        }
+
+        packet->resize(frame_size);
+        return fread(packet->data(), 1, frame_size, this->_file) == frame_size;
+    }
+
+
+    void Reader::decode(std::vector<unsigned char> const &packet, Image *frame) const {
+
+        frame->resize(this->_width, this->_height);
+        if (this->_format == RAW_RGB) {
+            std::copy(packet.begin(), packet.end(), frame->pixels.begin());
+            return;
+        }
+
+        int chroma_width = this->_chroma_420 ? (this->_width + 1) / 2 : this->_width;
+        int chroma_height = this->_chroma_420 ? (this->_height + 1) / 2 : this->_height;
+        unsigned long luma_size = (unsigned long) this->_width * this->_height;
+        unsigned long chroma_size = (unsigned long) chroma_width * chroma_height;
+
+        unsigned char const *y_plane = packet.data();
+        unsigned char const *u_plane = y_plane + luma_size;
+        unsigned char const *v_plane = u_plane + chroma_size;
+        int shift = this->_chroma_420 ? 1 : 0;
+        for (int row = 0; row < this->_height; ++row) {
+            unsigned char *out = frame->row(row);
+            unsigned char const *y_row = y_plane + (unsigned long) row * this->_width;
+            unsigned long chroma_row = (unsigned long) (row >> shift) * chroma_width;
+            for (int column = 0; column < this->_width; ++column, out += Image::CHANNELS) {
+                unsigned long chroma_idx = chroma_row + (column >> shift);
+                yuvToRgb(y_row[column], u_plane[chroma_idx], v_plane[chroma_idx], out);
+            }
+        }
+    }
+
+
+    void Reader::close() {
+        closeStream(this->_file);
+        this->_file = nullptr;
+    }
+
+
+    Format Reader::get_format() const {
+        return this->_format;
+    }
+
+
+    int Reader::get_width() const {
+        return this->_width;
+    }
+
+
+    int Reader::get_height() const {
+        return this->_height;
+    }
+
+
+    std::string const &Reader::get_frame_rate() const {
+        return this->_frame_rate;
+    }
+
+
+    /**
+     * c'tor
+     */
+    Writer::Writer()
+            : _file(nullptr)
+            , _format(RAW_RGB) {}
+
+
+    Writer::~Writer() {
+        this->close();
+    }
+
+
+    bool Writer::open(std::string const &path, Format format, int width, int height, std::string const &frame_rate) {
+
+        this->close();
+        this->_file = openStream(path, true);
+        if (this->_file == nullptr) {
+            std::cout << "failed to open '" << path << "'" << std::endl;
+            return false;
+        }
+        setvbuf(this->_file, nullptr, _IOFBF, STREAM_BUFFER_SIZE);
+        this->_format = format;
+
+        if (format == Y4M) {
+            fprintf(this->_file, "YUV4MPEG2 W%d H%d F%s Ip A1:1 C444\n", width, height, frame_rate.c_str());
+        }
+        return true;
+    }
+
+
+    void Writer::encode(Image const &frame, std::vector<unsigned char> *packet) const {
+
+        if (this->_format == RAW_RGB) {
+            packet->assign(frame.pixels.begin(), frame.pixels.end());
+            return;
+        }
+
+        unsigned long plane_size = (unsigned long) frame.width * frame.height;
+        packet->resize(3 * plane_size);
+        unsigned char *y_plane = packet->data();
+        unsigned char *u_plane = y_plane + plane_size;
+        unsigned char *v_plane = u_plane + plane_size;
+        for (unsigned long i = 0; i < plane_size; ++i) {
+            rgbToYuv(&frame.pixels[i * Image::CHANNELS], y_plane + i, u_plane + i, v_plane + i);
+        }
+    }
+
+
+    bool Writer::write(std::vector<unsigned char> const &packet) {
+        if (this->_format == Y4M) {
+            fputs("FRAME\n", this->_file);
+        }
+        return fwrite(packet.data(), 1, packet.size(), this->_file) == packet.size();
+    }
+
+
+    void Writer::close() {
+        closeStream(this->_file);
+        this->_file = nullptr;
+    }
+}
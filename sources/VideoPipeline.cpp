@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "VideoPipeline.hpp"
+
+// slots per worker, one being warped and one waiting to be picked up
+#define SLOTS_PER_WORKER 2
+
+/**
+ * c'tor
+ * @param engine
+ * @param num_workers
+ */
+VideoPipeline::VideoPipeline(WarpEngine const *engine, int num_workers)
+        : _engine(engine)
+        , _num_workers(std::max(num_workers, 1))
+        , _num_frames(0)
+        , _seconds(0.0) {
+    // the reader and the writer each hold on to one more
+    this->_slots.resize((unsigned long) (this->_num_workers * SLOTS_PER_WORKER + 2));
+}
+
+
+bool VideoPipeline::run(video::Reader *reader, video::Writer *writer) {
+
+    std::mutex mutex;
+    std::condition_variable slot_freed;
+    std::condition_variable frame_read;
+    std::condition_variable frame_warped;
+
+    std::deque<int> free_slots;
+    std::deque<int> read_slots;
+    std::map<unsigned long, int> warped_slots;
+    bool reading_done = false;
+    bool stopping = false;
+    int num_running_workers = this->_num_workers;
+
+    for (int slot_idx = 0; slot_idx < (int) this->_slots.size(); ++slot_idx) {
+        free_slots.push_back(slot_idx);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread reader_thread([&]() {
+        for (unsigned long sequence = 0;; ++sequence) {
+            int slot_idx;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slot_freed.wait(lock, [&] { return !free_slots.empty() || stopping; });
+                if (stopping) {
+                    break;
+                }
+                slot_idx = free_slots.front();
+                free_slots.pop_front();
+            }
+
+            // the slot belongs to this thread until it gets queued
+            Slot &slot = this->_slots[slot_idx];
+            if (!reader->read(&slot.input)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                free_slots.push_back(slot_idx);
+                break;
+            }
+            slot.sequence = sequence;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            read_slots.push_back(slot_idx);
+            frame_read.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        reading_done = true;
+        frame_read.notify_all();
+    });
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < this->_num_workers; ++i) {
+        workers.emplace_back([&]() {
+            for (;;) {
+                int slot_idx;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    frame_read.wait(lock, [&] { return !read_slots.empty() || reading_done; });
+                    if (read_slots.empty()) {
+                        break;
+                    }
+                    slot_idx = read_slots.front();
+                    read_slots.pop_front();
+                }
+
+                Slot &slot = this->_slots[slot_idx];
+                reader->decode(slot.input, &slot.source);
+                slot.failed = !this->_engine->warpSingleThreaded(slot.source, &slot.target);
+                if (!slot.failed) {
+                    writer->encode(slot.target, &slot.output);
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                warped_slots[slot.sequence] = slot_idx;
+                frame_warped.notify_one();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            --num_running_workers;
+            frame_warped.notify_one();
+        });
+    }
+
+    // write in order on this thread, after a failure the remaining frames only get drained
+    bool success = true;
+    unsigned long next_sequence = 0;
+    auto last_report = start;
+    for (;;) {
+        int slot_idx;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_warped.wait(lock, [&] {
+                return warped_slots.count(next_sequence) > 0 || (num_running_workers == 0 && warped_slots.empty());
+            });
+            auto next = warped_slots.find(next_sequence);
+            if (next == warped_slots.end()) {
+                break;
+            }
+            slot_idx = next->second;
+            warped_slots.erase(next);
+        }
+
+        Slot &slot = this->_slots[slot_idx];
+        if (success && (slot.failed || !writer->write(slot.output))) {
+            std::cout << "failed to warp frame " << slot.sequence << std::endl;
+            success = false;
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ++next_sequence;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_slots.push_back(slot_idx);
+            slot_freed.notify_one();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::seconds(1)) {
+            double elapsed = std::chrono::duration<double>(now - start).count();
+            std::cout << "\rframes: " << next_sequence << " fps: " << next_sequence / elapsed << std::flush;
+            last_report = now;
+        }
+    }
+
+    reader_thread.join();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    this->_num_frames = next_sequence;
+    this->_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return success;
+}
+
+
+unsigned long VideoPipeline::get_num_frames() const {
+    return this->_num_frames;
+}
+
+
+double VideoPipeline::get_fps() const {
+    return this->_seconds > 0.0 ? this->_num_frames / this->_seconds : 0.0;
+}
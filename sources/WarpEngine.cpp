@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Parallel.hpp"
+#include "WarpEngine.hpp"
+
+// rows per tile, for rasterizing as well as for warping
+#define TILE_ROWS 16
+
+// bilinear weights are fixed point with 8 fractional bits
+#define WEIGHT_BITS 8
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+
+/**
+ * c'tor
+ */
+WarpEngine::WarpEngine()
+        : _width(0)
+        , _height(0)
+        , _source_width(0)
+        , _source_height(0) {}
+
+
+void WarpEngine::setMesh(DomeMesh const &mesh, int width, int height) {
+
+    this->_width = width;
+    this->_height = height;
+    this->_lut_u.assign((unsigned long) width * height, -1.0f);
+    this->_lut_v.assign((unsigned long) width * height, -1.0f);
+
+    // vertices in pixel space, pixel centers sit at half coordinates
+    unsigned long num_vertices = mesh.numVertices();
+    std::vector<glm::vec2> positions(num_vertices);
+    std::vector<glm::vec2> coords(num_vertices);
+    for (unsigned long i = 0; i < num_vertices; ++i) {
+        float const *vertex = &mesh.vertices[i * DomeMesh::FLOATS_PER_VERTEX];
+        positions[i] = glm::vec2((vertex[0] * 0.5f + 0.5f) * width, (0.5f - vertex[1] * 0.5f) * height);
+        coords[i] = glm::vec2(vertex[2], vertex[3]);
+    }
+
+    // sort the triangles into the tiles they touch, so every tile can be filled on its own
+    int num_tiles = (height + TILE_ROWS - 1) / TILE_ROWS;
+    std::vector<std::vector<unsigned long>> tile_triangles((unsigned long) num_tiles);
+    unsigned long num_triangles = mesh.numIndices() / 3;
+    for (unsigned long t = 0; t < num_triangles; ++t) {
+        float y_min = std::min(std::min(positions[mesh.index(t * 3)].y, positions[mesh.index(t * 3 + 1)].y),
+                               positions[mesh.index(t * 3 + 2)].y);
+        float y_max = std::max(std::max(positions[mesh.index(t * 3)].y, positions[mesh.index(t * 3 + 1)].y),
+                               positions[mesh.index(t * 3 + 2)].y);
+        int first_tile = std::max((int) std::floor(y_min - 0.5f) / TILE_ROWS, 0);
+        int last_tile = std::min((int) std::ceil(y_max - 0.5f) / TILE_ROWS, num_tiles - 1);
+        for (int tile = first_tile; tile <= last_tile; ++tile) {
+            tile_triangles[tile].push_back(t);
+        }
+    }
+
+    parallel::forTiles(0, num_tiles, 1, [&](long tile_begin, long tile_end) {
+        for (long tile = tile_begin; tile < tile_end; ++tile) {
+            int tile_row_begin = (int) tile * TILE_ROWS;
+            int tile_row_end = std::min(tile_row_begin + TILE_ROWS, height);
+
+            for (unsigned long t : tile_triangles[tile]) {
+                unsigned int ia = mesh.index(t * 3);
+                unsigned int ib = mesh.index(t * 3 + 1);
+                unsigned int ic = mesh.index(t * 3 + 2);
+                glm::vec2 const &a = positions[ia];
+                glm::vec2 const &b = positions[ib];
+                glm::vec2 const &c = positions[ic];
+
+                float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+                if (std::abs(area) < 1e-12f) {
+                    continue;
+                }
+                float inv_area = 1.0f / area;
+
+                int x_begin = std::max((int) std::ceil(std::min(std::min(a.x, b.x), c.x) - 0.5f), 0);
+                int x_end = std::min((int) std::floor(std::max(std::max(a.x, b.x), c.x) - 0.5f) + 1, width);
+                int y_begin = std::max((int) std::ceil(std::min(std::min(a.y, b.y), c.y) - 0.5f), tile_row_begin);
+                int y_end = std::min((int) std::floor(std::max(std::max(a.y, b.y), c.y) - 0.5f) + 1, tile_row_end);
+
+                for (int y = y_begin; y < y_end; ++y) {
+                    float py = y + 0.5f;
+                    for (int x = x_begin; x < x_end; ++x) {
+                        float px = x + 0.5f;
+
+                        // barycentric weights, the sign of the area takes care of the winding
+                        float wa = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) * inv_area;
+                        float wb = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) * inv_area;
+                        float wc = 1.0f - wa - wb;
+                        if (wa < -1e-6f || wb < -1e-6f || wc < -1e-6f) {
+                            continue;
+                        }
+
+                        unsigned long idx = (unsigned long) y * width + x;
+                        this->_lut_u[idx] = wa * coords[ia].x + wb * coords[ib].x + wc * coords[ic].x;
+                        this->_lut_v[idx] = wa * coords[ia].y + wb * coords[ib].y + wc * coords[ic].y;
+                    }
+                }
+            }
+        }
+    });
+
+    this->updateTexels();
+}
+
+
+void WarpEngine::setSourceSize(int width, int height) {
+    this->_source_width = std::max(width, 2);
+    this->_source_height = std::max(height, 2);
+    this->updateTexels();
+}
+
+
+void WarpEngine::updateTexels() {
+
+    this->_texels.resize(this->_lut_u.size());
+    if (this->_source_width == 0) {
+        return;
+    }
+
+    // texel centers sit at half coordinates, the clamp keeps the 2x2 block inside the image
+    float scale_x = (float) this->_source_width;
+    float scale_y = (float) this->_source_height;
+    float max_x = (float) (this->_source_width - 1);
+    float max_y = (float) (this->_source_height - 1);
+
+    parallel::forTiles(0, (long) this->_texels.size(), TILE_ROWS * 1024, [&](long begin, long end) {
+        for (long i = begin; i < end; ++i) {
+            Texel &texel = this->_texels[i];
+            if (this->_lut_u[i] < 0.0f) {
+                texel.offset = -1;
+                texel.weight_x = 0;
+                texel.weight_y = 0;
+                continue;
+            }
+
+            float sx = std::min(std::max(this->_lut_u[i] * scale_x - 0.5f, 0.0f), max_x);
+            float sy = std::min(std::max(this->_lut_v[i] * scale_y - 0.5f, 0.0f), max_y);
+            int x0 = std::min((int) sx, this->_source_width - 2);
+            int y0 = std::min((int) sy, this->_source_height - 2);
+            texel.offset = (y0 * this->_source_width + x0) * Image::CHANNELS;
+            texel.weight_x = (unsigned short) ((sx - x0) * WEIGHT_ONE + 0.5f);
+            texel.weight_y = (unsigned short) ((sy - y0) * WEIGHT_ONE + 0.5f);
+        }
+    });
+}
+
+
+bool WarpEngine::prepareTarget(Image const &source, Image *target) const {
+
+    if (source.width != this->_source_width || source.height != this->_source_height) {
+        std::cout << "source is " << source.width << "x" << source.height << ", expected "
+                  << this->_source_width << "x" << this->_source_height << std::endl;
+        return false;
+    }
+
+    target->resize(this->_width, this->_height);
+    return true;
+}
+
+
+bool WarpEngine::warp(Image const &source, Image *target) const {
+
+    if (!this->prepareTarget(source, target)) {
+        return false;
+    }
+
+    parallel::forTiles(0, this->_height, TILE_ROWS, [&](long row_begin, long row_end) {
+        this->warpRows(source, target, (int) row_begin, (int) row_end);
+    });
+    return true;
+}
+
+
+bool WarpEngine::warpSingleThreaded(Image const &source, Image *target) const {
+
+    if (!this->prepareTarget(source, target)) {
+        return false;
+    }
+
+    this->warpRows(source, target, 0, this->_height);
+    return true;
+}
+
+
+#ifdef __SSE2__
+/**
+ * Loads two neighbouring rgb texels into the lower six bytes without reading past them
+ * @param texels
+ * @return
+ */
+static inline __m128i loadTexelPair(unsigned char const *texels) {
+    int first_four;
+    unsigned short last_two;
+    std::memcpy(&first_four, texels, 4);
+    std::memcpy(&last_two, texels + 4, 2);
+    return _mm_insert_epi16(_mm_cvtsi32_si128(first_four), last_two, 2);
+}
+
+
+/**
+ * Bilinear filter of a 2x2 texel block with SSE2
+ * @param top first texel of the upper row, the second one follows right after
+ * @param bottom first texel of the lower row
+ * @param fx horizontal weight of the right texels, 0..WEIGHT_ONE
+ * @param fy vertical weight of the lower texels, 0..WEIGHT_ONE
+ * @param out receives the rgb result
+ */
+static inline void sampleBilinear(unsigned char const *top, unsigned char const *bottom, int fx, int fy,
+                                  unsigned char *out) {
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i top_texels = _mm_unpacklo_epi8(loadTexelPair(top), zero);
+    __m128i bottom_texels = _mm_unpacklo_epi8(loadTexelPair(bottom), zero);
+
+    // vertical pass for both columns at once, the sums stay within 16 bit
+    __m128i column = _mm_add_epi16(_mm_mullo_epi16(top_texels, _mm_set1_epi16((short) (WEIGHT_ONE - fy))),
+                                   _mm_mullo_epi16(bottom_texels, _mm_set1_epi16((short) fy)));
+    column = _mm_srli_epi16(column, WEIGHT_BITS);
+
+    // horizontal pass, lanes 0-2 hold the left texel and lanes 3-5 the right one
+    short left = (short) (WEIGHT_ONE - fx);
+    short right = (short) fx;
+    __m128i weighted = _mm_mullo_epi16(column, _mm_setr_epi16(left, left, left, right, right, right, 0, 0));
+    __m128i blended = _mm_srli_epi16(_mm_add_epi16(weighted, _mm_srli_si128(weighted, 6)), WEIGHT_BITS);
+
+    int rgb = _mm_cvtsi128_si32(_mm_packus_epi16(blended, zero));
+    std::memcpy(out, &rgb, 3);
+}
+#else
+static inline void sampleBilinear(unsigned char const *top, unsigned char const *bottom, int fx, int fy,
+                                  unsigned char *out) {
+    for (int channel = 0; channel < Image::CHANNELS; ++channel) {
+        int upper = top[channel] * (WEIGHT_ONE - fx) + top[channel + Image::CHANNELS] * fx;
+        int lower = bottom[channel] * (WEIGHT_ONE - fx) + bottom[channel + Image::CHANNELS] * fx;
+        out[channel] = (unsigned char) ((upper * (WEIGHT_ONE - fy) + lower * fy) >> (2 * WEIGHT_BITS));
+    }
+}
+#endif
+
+
+void WarpEngine::warpRows(Image const &source, Image *target, int row_begin, int row_end) const {
+
+    unsigned char const *source_pixels = source.pixels.data();
+    long source_stride = (long) source.width * Image::CHANNELS;
+
+    for (int y = row_begin; y < row_end; ++y) {
+        unsigned char *out = target->row(y);
+        Texel const *texels = &this->_texels[(unsigned long) y * this->_width];
+
+        for (int x = 0; x < this->_width; ++x, out += Image::CHANNELS) {
+            Texel const &texel = texels[x];
+            if (texel.offset < 0) {
+                out[0] = out[1] = out[2] = 0;
+                continue;
+            }
+            unsigned char const *top = source_pixels + texel.offset;
+            sampleBilinear(top, top + source_stride, texel.weight_x, texel.weight_y, out);
+        }
+    }
+}
+
+
+int WarpEngine::get_width() const {
+    return this->_width;
+}
+
+
+int WarpEngine::get_height() const {
+    return this->_height;
+}
+
+
+unsigned long WarpEngine::numMappedPixels() const {
+    return (unsigned long) std::count_if(this->_lut_u.begin(), this->_lut_u.end(),
+                                         [](float u) { return u >= 0.0f; });
+}